@@ -0,0 +1,369 @@
+/*
+ * benchmark.cpp
+ */
+#include "benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <functional>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <sys/resource.h>
+#include "paginator.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+
+using namespace std;
+
+namespace {
+
+struct BenchmarkCorpus {
+    vector<string> vocabulary;
+    string stop_words;
+    vector<string> documents;
+    vector<DocumentStatus> statuses;
+    vector<vector<int>> ratings;
+    vector<string> queries;
+};
+
+// Слово по номеру в словаре: w + номер в 26-ричной записи буквами
+string MakeWord(size_t index) {
+    string word = "w"s;
+    do {
+        word += static_cast<char>('a' + index % 26);
+        index /= 26;
+    } while (index > 0);
+    return word;
+}
+
+// Выбор номера слова по закону Ципфа через таблицу накопленных вероятностей
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double skew) :
+            cdf_(size) {
+        double sum = 0.;
+        for (size_t rank = 0; rank < size; ++rank) {
+            sum += 1. / pow(static_cast<double>(rank + 1), skew);
+            cdf_[rank] = sum;
+        }
+        for (double &value : cdf_) {
+            value /= sum;
+        }
+    }
+
+    size_t operator()(mt19937 &generator) const {
+        const double value = uniform_real_distribution<double>(0., 1.)(generator);
+        const auto it = lower_bound(cdf_.begin(), cdf_.end(), value);
+        return min(static_cast<size_t>(it - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    vector<double> cdf_;
+};
+
+BenchmarkCorpus GenerateCorpus(const BenchmarkConfig &config) {
+    BenchmarkCorpus corpus;
+    mt19937 generator(config.seed);
+    const ZipfDistribution zipf(config.vocabulary_size, config.zipf_skew);
+
+    corpus.vocabulary.reserve(config.vocabulary_size);
+    for (size_t i = 0; i < config.vocabulary_size; ++i) {
+        corpus.vocabulary.push_back(MakeWord(i));
+    }
+    const size_t stop_word_count = static_cast<size_t>(config.stop_word_ratio
+            * static_cast<double>(config.vocabulary_size));
+    for (size_t i = 0; i < stop_word_count; ++i) {
+        corpus.stop_words += corpus.vocabulary[i] + ' ';
+    }
+
+    uniform_int_distribution<int> status_distribution(0, 3);
+    uniform_int_distribution<int> rating_distribution(-10, 10);
+    for (size_t id = 0; id < config.document_count; ++id) {
+        string document;
+        for (size_t i = 0; i < config.document_length; ++i) {
+            document += corpus.vocabulary[zipf(generator)] + ' ';
+        }
+        corpus.documents.push_back(move(document));
+        corpus.statuses.push_back(
+                static_cast<DocumentStatus>(status_distribution(generator)));
+        corpus.ratings.push_back( { rating_distribution(generator),
+                rating_distribution(generator), rating_distribution(generator) });
+    }
+
+    bernoulli_distribution minus_distribution(config.minus_word_ratio);
+    for (size_t q = 0; q < config.query_count; ++q) {
+        string query;
+        for (size_t i = 0; i < config.query_length; ++i) {
+            if (i > 0 && minus_distribution(generator)) {
+                query += '-';
+            }
+            query += corpus.vocabulary[zipf(generator)] + ' ';
+        }
+        corpus.queries.push_back(move(query));
+    }
+    return corpus;
+}
+
+long PeakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Собирает задержки отдельных операций одного бенчмарка
+class LatencyRecorder {
+public:
+    template<typename Operation>
+    void Measure(Operation operation) {
+        const auto start = chrono::steady_clock::now();
+        operation();
+        latencies_.push_back(chrono::steady_clock::now() - start);
+    }
+
+    void Report(string_view name, ostream &out) {
+        chrono::nanoseconds total { 0 };
+        for (const auto latency : latencies_) {
+            total += latency;
+        }
+        sort(latencies_.begin(), latencies_.end());
+        const double seconds = chrono::duration<double>(total).count();
+        out << "{\"benchmark\":\""s << name << "\",\"operations\":"s
+                << latencies_.size() << ",\"total_sec\":"s << seconds
+                << ",\"throughput_per_sec\":"s
+                << (seconds > 0. ? latencies_.size() / seconds : 0.)
+                << ",\"p50_us\":"s << Percentile(0.50) << ",\"p99_us\":"s
+                << Percentile(0.99) << ",\"peak_rss_kb\":"s << PeakRssKb()
+                << "}"s << endl;
+        latencies_.clear();
+    }
+
+private:
+    vector<chrono::nanoseconds> latencies_;
+
+    double Percentile(double rank) const {
+        if (latencies_.empty()) {
+            return 0.;
+        }
+        const size_t index = min(latencies_.size() - 1,
+                static_cast<size_t>(rank * static_cast<double>(latencies_.size())));
+        return chrono::duration<double, micro>(latencies_[index]).count();
+    }
+};
+
+}  // namespace
+
+BenchmarkConfig ParseBenchmarkConfig(const vector<string> &args) {
+    BenchmarkConfig config;
+    const map<string, function<void(const string&)>> setters = {
+        { "seed"s, [&config](const string &value) {
+            config.seed = static_cast<uint32_t>(stoul(value)); } },
+        { "vocabulary_size"s, [&config](const string &value) {
+            config.vocabulary_size = stoul(value); } },
+        { "zipf_skew"s, [&config](const string &value) {
+            config.zipf_skew = stod(value); } },
+        { "document_count"s, [&config](const string &value) {
+            config.document_count = stoul(value); } },
+        { "document_length"s, [&config](const string &value) {
+            config.document_length = stoul(value); } },
+        { "stop_word_ratio"s, [&config](const string &value) {
+            config.stop_word_ratio = stod(value); } },
+        { "query_count"s, [&config](const string &value) {
+            config.query_count = stoul(value); } },
+        { "query_length"s, [&config](const string &value) {
+            config.query_length = stoul(value); } },
+        { "minus_word_ratio"s, [&config](const string &value) {
+            config.minus_word_ratio = stod(value); } },
+        { "result_count"s, [&config](const string &value) {
+            config.result_count = stoul(value); } },
+        { "page_size"s, [&config](const string &value) {
+            config.page_size = stoul(value); } },
+    };
+
+    for (const string &arg : args) {
+        const size_t separator = arg.find('=');
+        if (separator == string::npos) {
+            throw invalid_argument("Ожидается аргумент вида key=value: `"s + arg
+                    + "`."s);
+        }
+        const auto setter = setters.find(arg.substr(0, separator));
+        if (setter == setters.end()) {
+            throw invalid_argument("Неизвестный параметр бенчмарка `"s + arg
+                    + "`."s);
+        }
+        try {
+            setter->second(arg.substr(separator + 1));
+        } catch (const logic_error&) {
+            throw invalid_argument("Некорректное значение параметра `"s + arg
+                    + "`."s);
+        }
+    }
+    ValidateBenchmarkConfig(config);
+    return config;
+}
+
+void ValidateBenchmarkConfig(const BenchmarkConfig &config) {
+    if (config.vocabulary_size == 0 || config.document_count == 0
+            || config.document_length == 0 || config.query_length == 0
+            || config.page_size == 0) {
+        throw invalid_argument("Размеры словаря, корпуса, документа, запроса и страницы должны быть больше нуля."s);
+    }
+    // Сравнения записаны так, чтобы NaN тоже отклонялся
+    const auto check_ratio = [](string_view name, double value) {
+        if (!(value >= 0. && value <= 1.)) {
+            throw invalid_argument("Параметр "s + string(name)
+                    + " должен быть от 0 до 1."s);
+        }
+    };
+    check_ratio("stop_word_ratio"sv, config.stop_word_ratio);
+    check_ratio("minus_word_ratio"sv, config.minus_word_ratio);
+    if (!(config.zipf_skew >= 0. && isfinite(config.zipf_skew))) {
+        throw invalid_argument("Параметр zipf_skew должен быть конечным и неотрицательным."s);
+    }
+}
+
+void RunBenchmarks(const BenchmarkConfig &config, ostream &out) {
+    ValidateBenchmarkConfig(config);
+    const BenchmarkCorpus corpus = GenerateCorpus(config);
+    out << "{\"config\":{\"seed\":"s << config.seed << ",\"vocabulary_size\":"s
+            << config.vocabulary_size << ",\"zipf_skew\":"s << config.zipf_skew
+            << ",\"document_count\":"s << config.document_count
+            << ",\"document_length\":"s << config.document_length
+            << ",\"stop_word_ratio\":"s << config.stop_word_ratio
+            << ",\"query_count\":"s << config.query_count
+            << ",\"query_length\":"s << config.query_length
+            << ",\"minus_word_ratio\":"s << config.minus_word_ratio
+            << ",\"result_count\":"s << config.result_count
+            << ",\"page_size\":"s << config.page_size << "}}"s << endl;
+
+    LatencyRecorder recorder;
+    SearchServer server { string_view(corpus.stop_words) };
+    server.SetMaxResultDocumentCount(config.result_count);
+    for (size_t id = 0; id < corpus.documents.size(); ++id) {
+        recorder.Measure([&] {
+            server.AddDocument(static_cast<int>(id), corpus.documents[id],
+                    corpus.statuses[id], corpus.ratings[id]);
+        });
+    }
+    recorder.Report("AddDocument"sv, out);
+
+    // Тот же корпус одним пакетом; одна операция — весь пакет
+    {
+        vector<SearchServer::DocumentToAdd> batch;
+        batch.reserve(corpus.documents.size());
+        for (size_t id = 0; id < corpus.documents.size(); ++id) {
+            batch.push_back( { static_cast<int>(id), corpus.documents[id],
+                    corpus.statuses[id], corpus.ratings[id] });
+        }
+        SearchServer bulk_server { string_view(corpus.stop_words) };
+        recorder.Measure([&] {
+            bulk_server.AddDocuments(batch);
+        });
+        recorder.Report("AddDocuments"sv, out);
+    }
+
+    // Сумма размеров выдачи не даёт компилятору выбросить вызовы
+    size_t checksum = 0;
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(query).size();
+        });
+    }
+    recorder.Report("FindTopDocuments"sv, out);
+
+    // Тот же поиск со сбором статистики запроса
+    for (const string &query : corpus.queries) {
+        QueryStats stats;
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(query, DocumentStatus::ACTUAL,
+                    stats).size();
+        });
+    }
+    recorder.Report("FindTopDocuments_stats"sv, out);
+
+    server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(query).size();
+        });
+    }
+    recorder.Report("FindTopDocuments_max_score"sv, out);
+    server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(query, DocumentStatus::BANNED).size();
+        });
+    }
+    recorder.Report("FindTopDocuments_status"sv, out);
+
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(query,
+                    [](int document_id, DocumentStatus, int rating) {
+                        return document_id % 2 == 0 && rating > 0;
+                    }).size();
+        });
+    }
+    recorder.Report("FindTopDocuments_predicate"sv, out);
+
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += server.FindTopDocuments(execution::par, query).size();
+        });
+    }
+    recorder.Report("FindTopDocuments_par"sv, out);
+
+    // Тот же корпус на четырёх шардах
+    {
+        ShardedSearchServer sharded(4, string_view(corpus.stop_words));
+        sharded.SetMaxResultDocumentCount(config.result_count);
+        for (size_t id = 0; id < corpus.documents.size(); ++id) {
+            sharded.AddDocument(static_cast<int>(id), corpus.documents[id],
+                    corpus.statuses[id], corpus.ratings[id]);
+        }
+        for (const string &query : corpus.queries) {
+            recorder.Measure([&] {
+                checksum += sharded.FindTopDocuments(query).size();
+            });
+        }
+        recorder.Report("FindTopDocuments_sharded"sv, out);
+    }
+
+    for (size_t i = 0; i < corpus.queries.size(); ++i) {
+        const int document_id = server.GetDocumentId(
+                static_cast<int>(i % corpus.documents.size()));
+        recorder.Measure([&] {
+            checksum += get<0>(server.MatchDocument(corpus.queries[i],
+                    document_id)).size();
+        });
+    }
+    recorder.Report("MatchDocument"sv, out);
+
+    for (const string &query : corpus.queries) {
+        const vector<Document> documents = server.FindTopDocuments(query);
+        if (documents.empty()) {
+            continue;
+        }
+        recorder.Measure([&] {
+            for (const auto &page : Paginate(documents, config.page_size)) {
+                checksum += page.size();
+            }
+        });
+    }
+    recorder.Report("Paginate"sv, out);
+
+    RequestQueue request_queue(server);
+    for (const string &query : corpus.queries) {
+        recorder.Measure([&] {
+            checksum += request_queue.AddFindRequest(query).size();
+        });
+    }
+    recorder.Report("RequestQueue_AddFindRequest"sv, out);
+
+    out << "{\"checksum\":"s << checksum << ",\"peak_rss_kb\":"s << PeakRssKb()
+            << "}"s << endl;
+}
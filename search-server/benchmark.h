@@ -0,0 +1,46 @@
+#pragma once
+/*
+ * benchmark.h
+ *
+ *  Микробенчмарки поискового сервера на синтетическом корпусе.
+ *  Корпус и запросы генерируются детерминированно по seed, поэтому
+ *  результаты разных сборок можно сравнивать между собой.
+ */
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkConfig {
+    uint32_t seed = 42;
+    // Размер словаря и параметр распределения Ципфа для частот слов
+    size_t vocabulary_size = 20000;
+    double zipf_skew = 1.0;
+    size_t document_count = 20000;
+    // Число слов в документе
+    size_t document_length = 50;
+    // Доля самых частых слов словаря, объявленных стоп-словами
+    double stop_word_ratio = 0.005;
+    size_t query_count = 2000;
+    size_t query_length = 5;
+    // Вероятность того, что слово запроса будет минус-словом
+    double minus_word_ratio = 0.2;
+    // Сколько документов возвращает FindTopDocuments и размер страницы для Paginate
+    size_t result_count = 50;
+    size_t page_size = 10;
+};
+
+// Разбирает аргументы вида key=value, например vocabulary_size=50000.
+// Неизвестный ключ или некорректное значение — std::invalid_argument.
+BenchmarkConfig ParseBenchmarkConfig(const std::vector<std::string> &args);
+
+// Размеры словаря, корпуса, документа, запроса и страницы больше нуля,
+// доли — от 0 до 1, параметр Ципфа конечен и неотрицателен; иначе
+// std::invalid_argument с описанием параметра.
+void ValidateBenchmarkConfig(const BenchmarkConfig &config);
+
+// Запускает все бенчмарки и пишет результаты в out, по одному JSON-объекту
+// на строку: имя, число операций, пропускная способность, p50/p99 задержки
+// в микросекундах и пиковое потребление памяти процессом. Конфигурация
+// проверяется до генерации корпуса (ValidateBenchmarkConfig).
+void RunBenchmarks(const BenchmarkConfig &config, std::ostream &out);
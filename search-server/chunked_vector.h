@@ -0,0 +1,110 @@
+#pragma once
+/*
+ * chunked_vector.h
+ *
+ *  Массив из частей по CHUNK_SIZE элементов. Копия массива разделяет части
+ *  с оригиналом и копирует только указатели на них; часть, общая с копией,
+ *  копируется при первом изменении. Так копия сервера (публикация версии,
+ *  см. live_search_server.h) стоит O(размер / CHUNK_SIZE), а писатель потом
+ *  копирует только те части, которые меняет.
+ *
+ *  Изменять массив и его копии можно только из одного потока; читать
+ *  неизменяемые копии — из любых.
+ */
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class ChunkedVector {
+public:
+    static constexpr size_t CHUNK_SIZE = 1024;
+
+    ChunkedVector() = default;
+    ChunkedVector(const ChunkedVector&) = default;
+    ChunkedVector& operator=(const ChunkedVector&) = default;
+
+    ChunkedVector(ChunkedVector &&other) noexcept :
+            chunks_(std::move(other.chunks_)), size_(
+                    std::exchange(other.size_, 0)) {
+        other.chunks_.clear();
+    }
+
+    ChunkedVector& operator=(ChunkedVector &&other) noexcept {
+        chunks_ = std::move(other.chunks_);
+        other.chunks_.clear();
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return (*chunks_[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    // Элемент для изменения; часть, общая с копией массива, копируется
+    T& Mutable(size_t index) {
+        std::shared_ptr<Chunk> &chunk = chunks_[index / CHUNK_SIZE];
+        if (chunk.use_count() > 1) {
+            chunk = std::make_shared<Chunk>(*chunk);
+        }
+        return (*chunk)[index % CHUNK_SIZE];
+    }
+
+    void PushBack(T value) {
+        if (size_ % CHUNK_SIZE == 0) {
+            chunks_.push_back(std::make_shared<Chunk>());
+        }
+        Mutable(size_++) = std::move(value);
+    }
+
+    // Новые элементы равны value
+    void Resize(size_t size, const T &value = T()) {
+        if (size < size_) {
+            chunks_.resize((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+            // Элементы за концом последней части не читаются, но держат
+            // память (например, shared_ptr), поэтому сбрасываются
+            for (size_t index = size; index < size_ && index % CHUNK_SIZE != 0;
+                    ++index) {
+                Mutable(index) = T();
+            }
+            size_ = size;
+            return;
+        }
+        for (; size_ < size && size_ % CHUNK_SIZE != 0; ++size_) {
+            Mutable(size_) = value;
+        }
+        while (size_ < size) {
+            auto chunk = std::make_shared<Chunk>();
+            chunk->fill(value);
+            chunks_.push_back(std::move(chunk));
+            size_ += std::min(CHUNK_SIZE, size - size_);
+        }
+    }
+
+    void Assign(size_t size, const T &value) {
+        Clear();
+        Resize(size, value);
+    }
+
+    void Clear() {
+        chunks_.clear();
+        size_ = 0;
+    }
+
+private:
+    using Chunk = std::array<T, CHUNK_SIZE>;
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
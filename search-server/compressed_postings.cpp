@@ -0,0 +1,189 @@
+/*
+ * compressed_postings.cpp
+ */
+#include "compressed_postings.h"
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+uint8_t BitWidth(uint32_t max_value) {
+    uint8_t bits = 0;
+    while (bits < 32 && (max_value >> bits) != 0) {
+        ++bits;
+    }
+    return bits;
+}
+
+size_t PackedBytes(size_t size, uint8_t bits) {
+    return (size * bits + 7) / 8;
+}
+
+void PackBits(const uint32_t *values, size_t size, uint8_t bits,
+        vector<uint8_t> &out) {
+    const size_t start = out.size();
+    out.resize(start + PackedBytes(size, bits), 0);
+    for (size_t i = 0; i < size; ++i) {
+        const size_t bit = i * bits;
+        uint64_t value = static_cast<uint64_t>(values[i]) << (bit % 8);
+        for (size_t byte = start + bit / 8; value != 0; ++byte, value >>= 8) {
+            out[byte] |= static_cast<uint8_t>(value);
+        }
+    }
+}
+
+// Читает по 8 байт на значение, поэтому за данными нужен POSTING_DATA_PADDING
+void UnpackBits(const uint8_t *in, size_t size, uint8_t bits,
+        uint32_t *values) {
+    if (bits == 0) {
+        fill(values, values + size, 0u);
+        return;
+    }
+    const uint64_t mask = (uint64_t { 1 } << bits) - 1;
+    for (size_t i = 0; i < size; ++i) {
+        const size_t bit = i * bits;
+        uint64_t word;
+        memcpy(&word, in + bit / 8, sizeof(word));
+        values[i] = static_cast<uint32_t>((word >> (bit % 8)) & mask);
+    }
+}
+
+struct UnpackedBlock {
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+    uint32_t counts[POSTING_BLOCK_SIZE];
+    uint32_t lengths[POSTING_BLOCK_SIZE];
+};
+
+void UnpackBlock(const PostingBlock &block, const uint8_t *data,
+        UnpackedBlock &unpacked, bool with_freqs) {
+    const uint8_t *in = data + block.offset;
+    UnpackBits(in, block.size, block.id_bits, unpacked.deltas);
+    if (with_freqs) {
+        in += PackedBytes(block.size, block.id_bits);
+        UnpackBits(in, block.size, block.count_bits, unpacked.counts);
+        in += PackedBytes(block.size, block.count_bits);
+        UnpackBits(in, block.size, block.length_bits, unpacked.lengths);
+    }
+}
+
+// Идентификатор после previous_id по разности - 1. Сложение беззнаковое:
+// от -1 до INT_MAX разность не помещается в int.
+int NextId(int previous_id, uint32_t delta) {
+    return static_cast<int>(static_cast<uint32_t>(previous_id) + delta + 1u);
+}
+
+// Идентификаторы — префиксные суммы (разность - 1), начиная с previous_id
+void RestoreIds(const uint32_t *deltas, size_t size, int previous_id,
+        int *document_ids) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i running = _mm_set1_epi32(previous_id);
+    for (; i + 4 <= size; i += 4) {
+        __m128i values = _mm_add_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i)),
+                one);
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi32(values, running);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(document_ids + i), values);
+        running = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    if (i > 0) {
+        previous_id = document_ids[i - 1];
+    }
+#endif
+    for (; i < size; ++i) {
+        previous_id = NextId(previous_id, deltas[i]);
+        document_ids[i] = previous_id;
+    }
+}
+
+// Частоты — (число вхождений + 1) / (длина документа + 1)
+void RestoreFreqs(const uint32_t *counts, const uint32_t *lengths, size_t size,
+        double *term_freqs) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi32(1);
+    for (; i + 2 <= size; i += 2) {
+        const __m128i count = _mm_add_epi32(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(counts + i)),
+                one);
+        const __m128i length = _mm_add_epi32(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(lengths + i)),
+                one);
+        _mm_storeu_pd(term_freqs + i,
+                _mm_div_pd(_mm_cvtepi32_pd(count), _mm_cvtepi32_pd(length)));
+    }
+#endif
+    for (; i < size; ++i) {
+        term_freqs[i] = static_cast<double>(counts[i] + 1)
+                / static_cast<double>(lengths[i] + 1);
+    }
+}
+
+}  // namespace
+
+size_t PostingBlockBytes(const PostingBlock &block) {
+    return PackedBytes(block.size, block.id_bits)
+            + PackedBytes(block.size, block.count_bits)
+            + PackedBytes(block.size, block.length_bits);
+}
+
+PostingBlock EncodePostingBlock(const PostingEntry *entries, size_t size,
+        int previous_id, vector<uint8_t> &data) {
+    // Числа вхождений и длины не меньше единицы, поэтому хранятся без неё:
+    // у большинства слов число вхождений 1 и занимает 0 бит
+    UnpackedBlock unpacked;
+    uint32_t max_delta = 0;
+    uint32_t max_count = 0;
+    uint32_t max_length = 0;
+    for (size_t i = 0; i < size; ++i) {
+        unpacked.deltas[i] = static_cast<uint32_t>(entries[i].document_id)
+                - static_cast<uint32_t>(previous_id) - 1u;
+        unpacked.counts[i] = entries[i].term_count - 1;
+        unpacked.lengths[i] = entries[i].document_length - 1;
+        previous_id = entries[i].document_id;
+        max_delta = max(max_delta, unpacked.deltas[i]);
+        max_count = max(max_count, unpacked.counts[i]);
+        max_length = max(max_length, unpacked.lengths[i]);
+    }
+
+    PostingBlock block;
+    block.last_document_id = previous_id;
+    block.offset = static_cast<uint32_t>(data.size());
+    block.size = static_cast<uint8_t>(size);
+    block.id_bits = BitWidth(max_delta);
+    block.count_bits = BitWidth(max_count);
+    block.length_bits = BitWidth(max_length);
+    PackBits(unpacked.deltas, size, block.id_bits, data);
+    PackBits(unpacked.counts, size, block.count_bits, data);
+    PackBits(unpacked.lengths, size, block.length_bits, data);
+    return block;
+}
+
+void DecodePostingBlock(const PostingBlock &block, const uint8_t *data,
+        int previous_id, PostingEntry *entries) {
+    UnpackedBlock unpacked;
+    UnpackBlock(block, data, unpacked, true);
+    for (size_t i = 0; i < block.size; ++i) {
+        previous_id = NextId(previous_id, unpacked.deltas[i]);
+        entries[i] = { previous_id, unpacked.counts[i] + 1, unpacked.lengths[i]
+                + 1 };
+    }
+}
+
+void DecodePostingBlock(const PostingBlock &block, const uint8_t *data,
+        int previous_id, int *document_ids, double *term_freqs) {
+    UnpackedBlock unpacked;
+    UnpackBlock(block, data, unpacked, term_freqs != nullptr);
+    RestoreIds(unpacked.deltas, block.size, previous_id, document_ids);
+    if (term_freqs != nullptr) {
+        RestoreFreqs(unpacked.counts, unpacked.lengths, block.size, term_freqs);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+/*
+ * compressed_postings.h
+ *
+ *  Сжатые списки вхождений. Вхождения разбиты на блоки по POSTING_BLOCK_SIZE.
+ *  В блоке разности соседних идентификаторов документов, числа вхождений
+ *  слова и длины документов упакованы каждые своей фиксированной разрядностью.
+ *  Частота слова не округляется: она восстанавливается как отношение числа
+ *  вхождений к длине документа. Описания блоков хранят последний
+ *  идентификатор блока и служат указателями пропуска при поиске документа.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+        "Posting blocks are unpacked with little-endian word loads");
+
+const size_t POSTING_BLOCK_SIZE = 128;
+// Нулевые байты после данных блоков: распаковка читает по 8 байт
+const size_t POSTING_DATA_PADDING = 8;
+
+struct PostingEntry {
+    int document_id;
+    uint32_t term_count;
+    uint32_t document_length;
+};
+
+struct PostingBlock {
+    int32_t last_document_id;
+    // Начало данных блока от начала данных списка
+    uint32_t offset;
+    uint8_t size;
+    uint8_t id_bits;
+    uint8_t count_bits;
+    uint8_t length_bits;
+};
+
+// Размер упакованных данных блока в байтах
+size_t PostingBlockBytes(const PostingBlock &block);
+
+// Упаковывает entries (по возрастанию идентификаторов, все больше previous_id)
+// и дописывает данные в конец data
+PostingBlock EncodePostingBlock(const PostingEntry *entries, size_t size,
+        int previous_id, std::vector<uint8_t> &data);
+
+// Полная распаковка блока; data — начало данных списка
+void DecodePostingBlock(const PostingBlock &block, const uint8_t *data,
+        int previous_id, PostingEntry *entries);
+
+// Распаковка для подсчёта релевантности: идентификаторы и частоты слова.
+// term_freqs может быть nullptr, если нужны только идентификаторы.
+void DecodePostingBlock(const PostingBlock &block, const uint8_t *data,
+        int previous_id, int *document_ids, double *term_freqs);
@@ -0,0 +1,81 @@
+#pragma once
+/*
+ * concurrent_map.h
+ *
+ *  Словарь, разбитый на независимые части (бакеты) со своими мьютексами.
+ *  Потоки, работающие с разными ключами, почти никогда не ждут друг друга.
+ */
+#include <algorithm>
+#include <execution>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+template<typename Key, typename Value>
+class ConcurrentMap {
+private:
+    struct Bucket {
+        std::mutex mutex;
+        std::map<Key, Value> map;
+    };
+
+public:
+    static_assert(std::is_integral_v<Key>,
+            "ConcurrentMap supports only integer keys");
+
+    struct Access {
+        std::lock_guard<std::mutex> guard;
+        Value &ref_to_value;
+
+        Access(const Key &key, Bucket &bucket) :
+                guard(bucket.mutex), ref_to_value(bucket.map[key]) {
+        }
+    };
+
+    explicit ConcurrentMap(size_t bucket_count) :
+            buckets_(bucket_count) {
+    }
+
+    Access operator[](const Key &key) {
+        return Access(key, GetBucket(key));
+    }
+
+    void Erase(const Key &key) {
+        Bucket &bucket = GetBucket(key);
+        std::lock_guard guard(bucket.mutex);
+        bucket.map.erase(key);
+    }
+
+    // Вызывает func(const std::map<Key, Value>&) для каждого бакета,
+    // бакеты обрабатываются согласно переданной политике выполнения
+    template<typename ExecutionPolicy, typename Function>
+    void ForEachBucket(ExecutionPolicy &&policy, Function func) {
+        std::for_each(policy, buckets_.begin(), buckets_.end(),
+                [&func](Bucket &bucket) {
+                    std::lock_guard guard(bucket.mutex);
+                    func(static_cast<const std::map<Key, Value>&>(bucket.map));
+                });
+    }
+
+    size_t BucketCount() const {
+        return buckets_.size();
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        std::map<Key, Value> result;
+        for (Bucket &bucket : buckets_) {
+            std::lock_guard guard(bucket.mutex);
+            result.insert(bucket.map.begin(), bucket.map.end());
+        }
+        return result;
+    }
+
+private:
+    std::vector<Bucket> buckets_;
+
+    Bucket& GetBucket(const Key &key) {
+        return buckets_[static_cast<std::make_unsigned_t<Key>>(key)
+                % buckets_.size()];
+    }
+};
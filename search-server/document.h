@@ -26,4 +26,18 @@ struct Document {
     int rating;
 };
 
+// Курсор постраничного поиска (search after): последний документ предыдущей
+// страницы. Следующая страница состоит из документов, которые идут в выдаче
+// строго после него.
+struct SearchAfter {
+    SearchAfter() = default;
+    explicit SearchAfter(const Document &last) :
+            relevance(last.relevance), rating(last.rating), id(last.id) {
+    }
+
+    double relevance = 0.;
+    int rating = 0;
+    int id = 0;
+};
+
 std::ostream& operator<<(std::ostream &out, const Document &document);
@@ -0,0 +1,91 @@
+/*
+ * document_bitmap.cpp
+ */
+#include "document_bitmap.h"
+#include <algorithm>
+
+using namespace std;
+
+DocumentBitmap::DocumentBitmap(pmr::memory_resource *resource) :
+        resource_(resource), containers_(resource) {
+}
+
+void DocumentBitmap::Add(int document_id) {
+    const uint16_t low = static_cast<uint16_t>(document_id & 0xFFFF);
+    Container &container = GetContainer(
+            static_cast<uint16_t>(document_id >> 16));
+    if (!container.bits.empty()) {
+        uint64_t &word = container.bits[low / 64];
+        const uint64_t mask = uint64_t { 1 } << (low % 64);
+        if ((word & mask) == 0) {
+            word |= mask;
+            ++size_;
+        }
+        return;
+    }
+
+    pmr::vector<uint16_t> &values = container.values;
+    if (values.empty() || values.back() < low) {
+        values.push_back(low);
+    } else {
+        const auto it = lower_bound(values.begin(), values.end(), low);
+        if (*it == low) {
+            return;
+        }
+        values.insert(it, low);
+    }
+    ++size_;
+    if (values.size() > ARRAY_LIMIT) {
+        container.bits.assign(BITMAP_WORDS, 0);
+        for (uint16_t value : values) {
+            container.bits[value / 64] |= uint64_t { 1 } << (value % 64);
+        }
+        values.clear();
+        values.shrink_to_fit();
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    if (document_id < 0) {
+        return false;
+    }
+    const uint16_t key = static_cast<uint16_t>(document_id >> 16);
+    const auto container = lower_bound(containers_.begin(), containers_.end(),
+            key, [](const Container &container, uint16_t key) {
+                return container.key < key;
+            });
+    if (container == containers_.end() || container->key != key) {
+        return false;
+    }
+    const uint16_t low = static_cast<uint16_t>(document_id & 0xFFFF);
+    if (!container->bits.empty()) {
+        return (container->bits[low / 64] >> (low % 64)) & 1;
+    }
+    return binary_search(container->values.begin(), container->values.end(),
+            low);
+}
+
+bool DocumentBitmap::Empty() const {
+    return size_ == 0;
+}
+
+size_t DocumentBitmap::Size() const {
+    return size_;
+}
+
+DocumentBitmap::Container& DocumentBitmap::GetContainer(uint16_t key) {
+    if (last_container_ < containers_.size()
+            && containers_[last_container_].key == key) {
+        return containers_[last_container_];
+    }
+    const auto it = lower_bound(containers_.begin(), containers_.end(), key,
+            [](const Container &container, uint16_t key) {
+                return container.key < key;
+            });
+    last_container_ = it - containers_.begin();
+    if (it == containers_.end() || it->key != key) {
+        containers_.insert(it, Container { key, pmr::vector<uint16_t>(
+                resource_), pmr::vector<uint64_t>(resource_) });
+    }
+    return containers_[last_container_];
+}
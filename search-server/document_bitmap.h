@@ -0,0 +1,45 @@
+#pragma once
+/*
+ * document_bitmap.h
+ *
+ *  Множество идентификаторов документов в духе roaring bitmap: старшие
+ *  16 бит идентификатора выбирают контейнер, младшие хранятся в нём
+ *  отсортированным массивом, пока их немного, или битовой картой на 2^16 бит.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+class DocumentBitmap {
+public:
+    explicit DocumentBitmap(std::pmr::memory_resource *resource =
+            std::pmr::get_default_resource());
+
+    // Идентификатор не должен быть отрицательным
+    void Add(int document_id);
+    bool Contains(int document_id) const;
+    bool Empty() const;
+    size_t Size() const;
+
+private:
+    // Больше стольких значений контейнер хранит битовой картой
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITMAP_WORDS = (1 << 16) / 64;
+
+    struct Container {
+        uint16_t key;
+        // Отсортированные младшие 16 бит, пока контейнер не стал битовой картой
+        std::pmr::vector<uint16_t> values;
+        std::pmr::vector<uint64_t> bits;
+    };
+
+    std::pmr::memory_resource *resource_;
+    // По возрастанию key
+    std::pmr::vector<Container> containers_;
+    size_t size_ = 0;
+    // Контейнер последнего добавления: идентификаторы обычно идут по порядку
+    size_t last_container_ = 0;
+
+    Container& GetContainer(uint16_t key);
+};
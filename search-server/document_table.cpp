@@ -0,0 +1,298 @@
+/*
+ * document_table.cpp
+ */
+#include "document_table.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_SLOT_COUNT = 64;
+// Массив по идентификатору занимает не больше 4 * 4 байт на номер — столько
+// же, сколько хеш-таблица, заполненная наполовину
+const size_t DIRECT_ID_RATIO = 4;
+const size_t INITIAL_DIRECT_SIZE = 64;
+
+// Младший единичный бит: длина отрезка узла дерева Фенвика
+size_t LowBit(size_t index) {
+    return index & (~index + 1);
+}
+
+}  // namespace
+
+bool DocumentTable::Contains(int document_id) const {
+    return Find(document_id) != NO_DOCUMENT;
+}
+
+uint32_t DocumentTable::Add(int document_id, int rating,
+        DocumentStatus status, shared_ptr<const DocumentTerms> terms) {
+    const uint32_t ordinal = static_cast<uint32_t>(ids_.Size());
+    Index(document_id, ordinal);
+    ids_.PushBack(document_id);
+    ratings_.PushBack(rating);
+    statuses_.PushBack(status);
+    terms_.PushBack(move(terms));
+
+    // Узел дерева с номером node (с единицы) покрывает номера
+    // (node - LowBit(node), node]: это сам документ и узлы-предшественники
+    const size_t node = ids_.Size();
+    uint32_t live = 1;
+    for (size_t child = node - 1; child > node - LowBit(node);
+            child -= LowBit(child)) {
+        live += live_tree_[child - 1];
+    }
+    live_tree_.PushBack(live);
+    return ordinal;
+}
+
+bool DocumentTable::Remove(int document_id) {
+    const uint32_t ordinal = Find(document_id);
+    if (ordinal == NO_DOCUMENT) {
+        return false;
+    }
+    if (direct_) {
+        ordinal_by_id_.Mutable(document_id) = NO_DOCUMENT;
+    } else {
+        // Удаление со сдвигом назад: ячейки цепочки, которые можно найти
+        // только через освободившуюся, переезжают в неё
+        size_t index = FindSlot(document_id);
+        const size_t mask = slots_.Size() - 1;
+        for (size_t next = (index + 1) & mask;
+                slots_[next].ordinal != NO_DOCUMENT;
+                next = (next + 1) & mask) {
+            const size_t home = Hash(slots_[next].document_id) & mask;
+            if (((next - home) & mask) >= ((next - index) & mask)) {
+                slots_.Mutable(index) = slots_[next];
+                index = next;
+            }
+        }
+        slots_.Mutable(index) = Slot();
+    }
+
+    ids_.Mutable(ordinal) = REMOVED;
+    terms_.Mutable(ordinal).reset();
+    ++removed_count_;
+    for (size_t node = ordinal + 1; node <= live_tree_.Size();
+            node += LowBit(node)) {
+        --live_tree_.Mutable(node - 1);
+    }
+    // Уплотнение стоит O(числа номеров) и случается не чаще, чем раз на
+    // столько удалений, сколько осталось документов
+    if (removed_count_ > Size()) {
+        Compact();
+    }
+    return true;
+}
+
+void DocumentTable::Reserve(size_t count) {
+    if (direct_) {
+        return;
+    }
+    size_t slot_count = max(INITIAL_SLOT_COUNT, slots_.Size());
+    while (count * 2 > slot_count) {
+        slot_count *= 2;
+    }
+    if (slot_count != slots_.Size()) {
+        Rehash(slot_count);
+    }
+}
+
+size_t DocumentTable::Size() const {
+    return ids_.Size() - removed_count_;
+}
+
+uint32_t DocumentTable::OrdinalCount() const {
+    return static_cast<uint32_t>(ids_.Size());
+}
+
+bool DocumentTable::IsRemoved(uint32_t ordinal) const {
+    return ids_[ordinal] == REMOVED;
+}
+
+bool DocumentTable::IsDirect() const {
+    return direct_;
+}
+
+uint32_t DocumentTable::OrdinalAt(size_t index) const {
+    if (removed_count_ == 0) {
+        return static_cast<uint32_t>(index);
+    }
+    // Спуск по дереву: самый правый узел, до которого документов не больше index
+    size_t node = 0;
+    size_t step = 1;
+    while (step * 2 <= live_tree_.Size()) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (node + step <= live_tree_.Size()
+                && live_tree_[node + step - 1] <= index) {
+            node += step;
+            index -= live_tree_[node - 1];
+        }
+    }
+    return static_cast<uint32_t>(node);
+}
+
+int DocumentTable::Id(uint32_t ordinal) const {
+    return ids_[ordinal];
+}
+
+int DocumentTable::Rating(uint32_t ordinal) const {
+    return ratings_[ordinal];
+}
+
+DocumentStatus DocumentTable::Status(uint32_t ordinal) const {
+    return statuses_[ordinal];
+}
+
+const shared_ptr<const DocumentTerms>& DocumentTable::Terms(
+        uint32_t ordinal) const {
+    return terms_[ordinal];
+}
+
+vector<int> DocumentTable::Ids() const {
+    vector<int> ids;
+    ids.reserve(Size());
+    for (size_t ordinal = 0; ordinal < ids_.Size(); ++ordinal) {
+        if (ids_[ordinal] != REMOVED) {
+            ids.push_back(ids_[ordinal]);
+        }
+    }
+    return ids;
+}
+
+uint32_t DocumentTable::Hash(int document_id) {
+    uint32_t hash = static_cast<uint32_t>(document_id);
+    hash ^= hash >> 16;
+    hash *= 0x45D9F3Bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+uint32_t DocumentTable::FindInSlots(int document_id) const {
+    if (slots_.Empty()) {
+        return NO_DOCUMENT;
+    }
+    return slots_[FindSlot(document_id)].ordinal;
+}
+
+void DocumentTable::Index(int document_id, uint32_t ordinal) {
+    max_id_ = max(max_id_, document_id);
+    const size_t direct_limit = DIRECT_ID_RATIO
+            * max(INITIAL_DIRECT_SIZE, ids_.Size() + 1);
+    const bool fits = static_cast<size_t>(max_id_) < direct_limit;
+    // К массиву таблица возвращается вместо перестроения хеш-таблицы:
+    // переезд стоит столько же
+    if (!direct_ && fits && (Size() + 1) * 2 > slots_.Size()) {
+        SetDirect(true);
+    }
+    if (direct_) {
+        const size_t index = static_cast<size_t>(document_id);
+        if (index >= ordinal_by_id_.Size()) {
+            if (!fits) {
+                SetDirect(false);
+                Index(document_id, ordinal);
+                return;
+            }
+            ordinal_by_id_.Resize(
+                    min(direct_limit,
+                            max(index + 1, ordinal_by_id_.Size() * 2)),
+                    NO_DOCUMENT);
+        }
+        ordinal_by_id_.Mutable(index) = ordinal;
+        return;
+    }
+    if ((Size() + 1) * 2 > slots_.Size()) {
+        Rehash(max(INITIAL_SLOT_COUNT, slots_.Size() * 2));
+    }
+    slots_.Mutable(FindSlot(document_id)) = { document_id, ordinal };
+}
+
+void DocumentTable::SetDirect(bool direct) {
+    direct_ = direct;
+    ordinal_by_id_.Clear();
+    slots_.Clear();
+    if (direct) {
+        ordinal_by_id_.Assign(static_cast<size_t>(max_id_) + 1, NO_DOCUMENT);
+    } else {
+        size_t slot_count = INITIAL_SLOT_COUNT;
+        while ((Size() + 1) * 2 > slot_count) {
+            slot_count *= 2;
+        }
+        slots_.Assign(slot_count, Slot());
+    }
+    for (uint32_t ordinal = 0; ordinal < ids_.Size(); ++ordinal) {
+        if (ids_[ordinal] == REMOVED) {
+            continue;
+        }
+        if (direct) {
+            ordinal_by_id_.Mutable(ids_[ordinal]) = ordinal;
+        } else {
+            slots_.Mutable(FindSlot(ids_[ordinal])) = { ids_[ordinal],
+                    ordinal };
+        }
+    }
+}
+
+size_t DocumentTable::FindSlot(int document_id) const {
+    const size_t mask = slots_.Size() - 1;
+    for (size_t index = Hash(document_id) & mask;; index = (index + 1) & mask) {
+        const Slot &slot = slots_[index];
+        if (slot.ordinal == NO_DOCUMENT || slot.document_id == document_id) {
+            return index;
+        }
+    }
+}
+
+void DocumentTable::Rehash(size_t slot_count) {
+    const ChunkedVector<Slot> old_slots = move(slots_);
+    slots_.Assign(slot_count, Slot());
+    const size_t mask = slot_count - 1;
+    for (size_t old_index = 0; old_index < old_slots.Size(); ++old_index) {
+        const Slot &slot = old_slots[old_index];
+        if (slot.ordinal == NO_DOCUMENT) {
+            continue;
+        }
+        size_t index = Hash(slot.document_id) & mask;
+        while (slots_[index].ordinal != NO_DOCUMENT) {
+            index = (index + 1) & mask;
+        }
+        slots_.Mutable(index) = slot;
+    }
+}
+
+void DocumentTable::Compact() {
+    size_t size = 0;
+    for (size_t ordinal = 0; ordinal < ids_.Size(); ++ordinal) {
+        if (ids_[ordinal] == REMOVED) {
+            continue;
+        }
+        // Части до первого пустого номера не меняются и не копируются
+        if (size != ordinal) {
+            const int document_id = ids_[ordinal];
+            ids_.Mutable(size) = document_id;
+            ratings_.Mutable(size) = ratings_[ordinal];
+            statuses_.Mutable(size) = statuses_[ordinal];
+            terms_.Mutable(size) = move(terms_.Mutable(ordinal));
+            if (direct_) {
+                ordinal_by_id_.Mutable(document_id) =
+                        static_cast<uint32_t>(size);
+            } else {
+                slots_.Mutable(FindSlot(document_id)).ordinal =
+                        static_cast<uint32_t>(size);
+            }
+        }
+        ++size;
+    }
+    ids_.Resize(size);
+    ratings_.Resize(size);
+    statuses_.Resize(size);
+    terms_.Resize(size);
+    removed_count_ = 0;
+    // Все номера заняты: узел покрывает LowBit(node) документов
+    live_tree_.Clear();
+    for (size_t node = 1; node <= size; ++node) {
+        live_tree_.PushBack(static_cast<uint32_t>(LowBit(node)));
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+/*
+ * document_table.h
+ *
+ *  Документы сервера по плотным порядковым номерам в порядке добавления.
+ *  Идентификатор, рейтинг, статус и слова документа лежат в отдельных
+ *  массивах по номеру (ChunkedVector: копия таблицы разделяет их части).
+ *  Пока идентификаторы невелики относительно числа документов, номер
+ *  ищется в массиве по идентификатору, иначе — в хеш-таблице с открытой
+ *  адресацией.
+ *  Удалённый документ оставляет пустой номер; когда пустых номеров больше,
+ *  чем документов, массивы уплотняются и документы нумеруются заново.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "chunked_vector.h"
+#include "document.h"
+
+// Слова документа в прямом индексе: термины по возрастанию
+// идентификаторов с частотами. Не меняются после добавления документа
+// и общие у копий сервера.
+struct DocumentTerms {
+    std::vector<uint32_t> term_ids;
+    std::vector<double> term_freqs;
+    // Словарь для GetWordFrequencies строится при первом обращении
+    mutable std::once_flag word_freqs_built;
+    mutable std::map<std::string_view, double> word_freqs;
+};
+
+class DocumentTable {
+public:
+    static constexpr uint32_t NO_DOCUMENT = std::numeric_limits<uint32_t>::max();
+
+    // NO_DOCUMENT, если документа нет
+    uint32_t Find(int document_id) const {
+        if (direct_) {
+            const size_t index = static_cast<uint32_t>(document_id);
+            return index < ordinal_by_id_.Size() ?
+                    ordinal_by_id_[index] : NO_DOCUMENT;
+        }
+        return FindInSlots(document_id);
+    }
+    bool Contains(int document_id) const;
+    // Документ получает следующий номер; идентификатор не должен быть
+    // отрицательным и уже добавленным
+    uint32_t Add(int document_id, int rating, DocumentStatus status,
+            std::shared_ptr<const DocumentTerms> terms = nullptr);
+    // Номер документа становится пустым, номера остальных не меняются, пока
+    // не случится уплотнение. Порядок добавления сохраняется. false, если
+    // документа нет.
+    bool Remove(int document_id);
+    // Место в хеш-таблице для count документов
+    void Reserve(size_t count);
+    // Число документов
+    size_t Size() const;
+    // Номера документов меньше OrdinalCount(), среди них бывают пустые
+    uint32_t OrdinalCount() const;
+    bool IsRemoved(uint32_t ordinal) const;
+    // true, пока Find — чтение из массива по идентификатору без хеширования
+    bool IsDirect() const;
+    // Номер документа, index-го по порядку добавления
+    uint32_t OrdinalAt(size_t index) const;
+
+    int Id(uint32_t ordinal) const;
+    int Rating(uint32_t ordinal) const;
+    DocumentStatus Status(uint32_t ordinal) const;
+    // Слова, переданные в Add
+    const std::shared_ptr<const DocumentTerms>& Terms(uint32_t ordinal) const;
+    // Идентификаторы в порядке добавления
+    std::vector<int> Ids() const;
+
+    // Перемешивает биты идентификатора: идентификаторы с общими младшими
+    // битами (кратные степени двойки) не собираются в одну цепочку
+    static uint32_t Hash(int document_id);
+
+private:
+    // Идентификатор пустого номера
+    static constexpr int REMOVED = -1;
+
+    struct Slot {
+        int document_id = 0;
+        uint32_t ordinal = NO_DOCUMENT;
+    };
+
+    ChunkedVector<int> ids_;
+    ChunkedVector<int> ratings_;
+    ChunkedVector<DocumentStatus> statuses_;
+    ChunkedVector<std::shared_ptr<const DocumentTerms>> terms_;
+    size_t removed_count_ = 0;
+    // Дерево Фенвика по номерам: число документов на отрезках номеров,
+    // ищет номер по позиции в порядке добавления за O(log n)
+    ChunkedVector<uint32_t> live_tree_;
+    // Номер по идентификатору, пока наибольший идентификатор меньше
+    // DIRECT_ID_RATIO * числа номеров; иначе номер ищется в slots_
+    bool direct_ = true;
+    int max_id_ = 0;
+    ChunkedVector<uint32_t> ordinal_by_id_;
+    // Размер — степень двойки, заполнено не больше половины ячеек
+    ChunkedVector<Slot> slots_;
+
+    uint32_t FindInSlots(int document_id) const;
+    // Запоминает номер документа в массиве или хеш-таблице
+    void Index(int document_id, uint32_t ordinal);
+    // Переносит документы в массив по идентификатору или в хеш-таблицу
+    void SetDirect(bool direct);
+    // Ячейка документа или пустая ячейка, где он должен лежать
+    size_t FindSlot(int document_id) const;
+    void Rehash(size_t slot_count);
+    // Удаляет пустые номера и перестраивает хеш-таблицу и дерево
+    void Compact();
+};
@@ -0,0 +1,94 @@
+/*
+ * live_search_server.cpp
+ */
+#include "live_search_server.h"
+#include <thread>
+
+using namespace std;
+
+LiveSearchServer::LiveSearchServer(SearchServer server) :
+        writer_(move(server)), published_version_(
+                make_unique<const SearchServer>(writer_)), published_(
+                published_version_.get()) {
+}
+
+void LiveSearchServer::AddDocument(int document_id, string_view document,
+        DocumentStatus status, const vector<int> &ratings) {
+    writer_.AddDocument(document_id, document, status, ratings);
+}
+
+void LiveSearchServer::RemoveDocument(int document_id) {
+    writer_.RemoveDocument(document_id);
+}
+
+void LiveSearchServer::SetMaxResultDocumentCount(size_t count) {
+    writer_.SetMaxResultDocumentCount(count);
+}
+
+const SearchServer& LiveSearchServer::GetWriterServer() const {
+    return writer_;
+}
+
+void LiveSearchServer::Publish() {
+    // Копия разделяет данные с рабочей, поэтому она дешевле индекса
+    // и следующие изменения писателя не затронут опубликованную версию
+    unique_ptr<const SearchServer> version = make_unique<const SearchServer>(
+            writer_);
+    published_.store(version.get());
+    WaitForReaders();
+    published_version_ = move(version);
+}
+
+tuple<vector<string>, DocumentStatus> LiveSearchServer::MatchDocument(
+        string_view raw_query, int document_id) const {
+    // Слова копируются: опубликованная версия может смениться после чтения
+    return Read([&](const SearchServer &server) {
+        auto [words, status] = server.MatchDocument(raw_query, document_id);
+        return tuple(vector<string>(words.begin(), words.end()), status);
+    });
+}
+
+int LiveSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer &server) {
+        return server.GetDocumentCount();
+    });
+}
+
+uint64_t LiveSearchServer::GetGeneration() const {
+    return Read([](const SearchServer &server) {
+        return server.GetGeneration();
+    });
+}
+
+void LiveSearchServer::WaitForReaders() {
+    // Новые читатели регистрируются в другом счётчике и видят уже новую
+    // версию, так что достаточно дождаться опустения прежнего
+    const uint64_t old_epoch = epoch_.fetch_add(1);
+    const ReaderCounter &old_readers = readers_[old_epoch % readers_.size()];
+    while (old_readers.count.load() != 0) {
+        this_thread::yield();
+    }
+}
+
+LiveSearchServer::ReadGuard::ReadGuard(const LiveSearchServer &live) :
+        live_(live) {
+    while (true) {
+        const uint64_t epoch = live_.epoch_.load();
+        slot_ = epoch % live_.readers_.size();
+        live_.readers_[slot_].count.fetch_add(1);
+        // Если эпоха сменилась, писатель мог уже проверить этот счётчик
+        if (live_.epoch_.load() == epoch) {
+            break;
+        }
+        live_.readers_[slot_].count.fetch_sub(1);
+    }
+    server_ = live_.published_.load();
+}
+
+LiveSearchServer::ReadGuard::~ReadGuard() {
+    live_.readers_[slot_].count.fetch_sub(1);
+}
+
+const SearchServer& LiveSearchServer::ReadGuard::Server() const {
+    return *server_;
+}
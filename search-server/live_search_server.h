@@ -0,0 +1,107 @@
+#pragma once
+/*
+ * live_search_server.h
+ *
+ *  Поисковый сервер для одновременных запросов и индексации. Один поток-
+ *  писатель меняет рабочую копию индекса и публикует её неизменяемые версии,
+ *  читатели без блокировок работают с последней опубликованной версией.
+ *
+ *  Версии — копии SearchServer, которые разделяют с рабочей копией списки
+ *  вхождений, прямой индекс и части таблиц (chunked_vector.h), поэтому
+ *  публикация копирует только указатели на части и не удваивает память.
+ *  Старая версия удаляется, когда её отпустили все читатели (эпохи, как в RCU).
+ */
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+class LiveSearchServer {
+public:
+    // Начальная версия — переданный сервер, она сразу опубликована
+    explicit LiveSearchServer(SearchServer server);
+
+    LiveSearchServer(const LiveSearchServer&) = delete;
+    LiveSearchServer& operator=(const LiveSearchServer&) = delete;
+
+    // Методы писателя, вызываются из одного потока. Изменения не видны
+    // читателям до вызова Publish.
+    void AddDocument(int document_id, std::string_view document,
+            DocumentStatus status, const std::vector<int> &ratings);
+    void RemoveDocument(int document_id);
+    void SetMaxResultDocumentCount(size_t count);
+    // Рабочая копия писателя
+    const SearchServer& GetWriterServer() const;
+    // Публикует рабочую копию и ждёт, пока читатели отпустят прежнюю версию
+    void Publish();
+
+    // Методы читателей, вызываются из любых потоков. Read вызывает
+    // func(const SearchServer&) для одной версии индекса, поэтому несколько
+    // обращений внутри func согласованы между собой. Результат func не должен
+    // ссылаться на данные сервера.
+    template<typename Func>
+    auto Read(Func func) const;
+
+    template<typename ... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(
+            std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    uint64_t GetGeneration() const;
+
+private:
+    // Регистрирует читателя в текущей эпохе на время жизни объекта
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const LiveSearchServer &live);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const SearchServer& Server() const;
+
+    private:
+        const LiveSearchServer &live_;
+        size_t slot_;
+        const SearchServer *server_;
+    };
+
+    // Счётчик читателей на отдельной строке кэша
+    struct alignas(64) ReaderCounter {
+        std::atomic<int64_t> count { 0 };
+    };
+
+    SearchServer writer_;
+    // Владеет опубликованной версией; меняется только писателем
+    std::unique_ptr<const SearchServer> published_version_;
+    std::atomic<const SearchServer*> published_;
+    // Чётность эпохи выбирает счётчик, в котором регистрируются новые читатели
+    mutable std::atomic<uint64_t> epoch_ { 0 };
+    mutable std::array<ReaderCounter, 2> readers_;
+
+    // Дожидается выхода читателей, которые могли видеть прежнюю версию
+    void WaitForReaders();
+};
+
+template<typename Func>
+auto LiveSearchServer::Read(Func func) const {
+    const ReadGuard guard(*this);
+    return func(guard.Server());
+}
+
+template<typename ... Args>
+std::vector<Document> LiveSearchServer::FindTopDocuments(Args&&... args) const {
+    return Read([&](const SearchServer &server) {
+        return server.FindTopDocuments(std::forward<Args>(args)...);
+    });
+}
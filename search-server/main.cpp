@@ -9,12 +9,31 @@
 using namespace std;
 
 #include "paginator.h"
+#include "process_queries.h"
 #include "document.h"
 #include "request_queue.h"
 #include "search_server.h"
 #include "unit_test.h"
+#include "benchmark.h"
 
-int main() {
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Без аргументов запускаются юнит-тесты.
+// `--benchmark [key=value ...]` запускает бенчмарки, параметры см. в benchmark.h
+int main(int argc, char *argv[]) {
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        try {
+            const vector<string> args(argv + 2, argv + argc);
+            RunBenchmarks(ParseBenchmarkConfig(args), cout);
+        } catch (const invalid_argument &error) {
+            cerr << error.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
     TestSearchServer();
     return 0;
 }
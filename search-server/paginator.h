@@ -6,23 +6,17 @@
  *      Author: vitasan
  */
 #include <algorithm>
-#include <vector>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 template<typename Iterator>
 class IteratorRange {
 public:
 
-    explicit IteratorRange(const Iterator &p_begin, const Iterator &p_end) {
-        begin_ = p_begin;
-        end_ = p_end;
-        if (p_begin == p_end) {
-            size_ = 1;
-        } else {
-            for (Iterator it = p_begin; it != p_end; ++it) {
-                ++size_;
-            }
-        }
+    explicit IteratorRange(const Iterator &p_begin, const Iterator &p_end) :
+            begin_(p_begin), end_(p_end), size_(std::distance(p_begin, p_end)) {
     }
 
     auto begin() const {
@@ -53,48 +47,89 @@ std::ostream& operator<<(std::ostream &os,
     return os;
 }
 
+// Ленивое разбиение диапазона на страницы: страницы не хранятся, а строятся
+// при обращении, для итераторов произвольного доступа — за O(1)
 template<typename Iterator>
 class Paginator {
 public:
 
-    explicit Paginator(const Iterator &p_begin, const Iterator &p_end,
-            size_t page_size) {
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
 
-        for (Iterator it = p_begin; it != p_end; ++it) {
-            ++size_;
+        PageIterator(const Paginator *paginator, size_t page) :
+                paginator_(paginator), page_(page) {
         }
-        if (size_ == 0) {
-            using std::operator""s;
-            throw std::invalid_argument("Ничего не найдено"s);
+
+        IteratorRange<Iterator> operator*() const {
+            return (*paginator_)[page_];
+        }
+        PageIterator& operator++() {
+            ++page_;
+            return *this;
+        }
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++page_;
+            return previous;
         }
+        bool operator==(const PageIterator &other) const {
+            return page_ == other.page_;
+        }
+        bool operator!=(const PageIterator &other) const {
+            return page_ != other.page_;
+        }
+
+    private:
+        const Paginator *paginator_;
+        size_t page_;
+    };
 
-        Iterator p_begin_tmp = p_begin;
-        Iterator p_end_tmp = p_end;
-        for (size_t left = distance(p_begin_tmp, p_end_tmp); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = next(p_begin_tmp,
-                    current_page_size);
-            IteratorRange result(p_begin_tmp, current_page_end); // @suppress("Type cannot be resolved")
-            pages_.push_back(result);
-            left -= current_page_size;
-            p_begin_tmp = current_page_end;
+    // Пустой диапазон даёт ноль страниц
+    explicit Paginator(const Iterator &p_begin, const Iterator &p_end,
+            size_t page_size) :
+            begin_(p_begin), size_(std::distance(p_begin, p_end)), page_size_(
+                    page_size) {
+        if (page_size_ == 0) {
+            using std::operator""s;
+            throw std::invalid_argument("Размер страницы должен быть больше нуля."s);
         }
     }
 
-    auto begin() const {
-        return pages_.begin();
+    // Число страниц
+    size_t size() const {
+        return (size_ + page_size_ - 1) / page_size_;
     }
-    auto end() const {
-        return pages_.end();
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // page < size()
+    IteratorRange<Iterator> operator[](size_t page) const {
+        const size_t first = page * page_size_;
+        const Iterator page_begin = std::next(begin_, first);
+        return IteratorRange<Iterator>(page_begin,
+                std::next(page_begin, std::min(page_size_, size_ - first)));
+    }
+
+    PageIterator begin() const {
+        return PageIterator(this, 0);
+    }
+    PageIterator end() const {
+        return PageIterator(this, size());
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
     size_t size_ = 0;
+    size_t page_size_ = 0;
 };
 
 template<typename Container>
 auto Paginate(const Container &c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
-
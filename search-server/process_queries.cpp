@@ -0,0 +1,78 @@
+/*
+ * process_queries.cpp
+ */
+#include "process_queries.h"
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+// Исключение из параллельного алгоритма завершило бы программу, поэтому
+// ошибки запросов сохраняются и первая из них бросается после обработки
+void RethrowFirstError(const vector<exception_ptr> &errors) {
+    for (const exception_ptr &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace
+
+vector<vector<Document>> ProcessQueries(const SearchServer &search_server,
+        const vector<string> &queries) {
+    vector<vector<Document>> result(queries.size());
+    vector<exception_ptr> errors(queries.size());
+    vector<size_t> indexes(queries.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(execution::par, indexes.begin(), indexes.end(),
+            [&](size_t index) {
+                try {
+                    result[index] = search_server.FindTopDocuments(
+                            queries[index]);
+                } catch (...) {
+                    errors[index] = current_exception();
+                }
+            });
+    RethrowFirstError(errors);
+    return result;
+}
+
+vector<Document> ProcessQueriesJoined(const SearchServer &search_server,
+        const vector<string> &queries) {
+    // На каждый запрос приходится не больше max_count документов
+    const size_t max_count = min(search_server.GetMaxResultDocumentCount(),
+            static_cast<size_t>(search_server.GetDocumentCount()));
+    vector<Document> buffer(queries.size() * max_count);
+    vector<size_t> counts(queries.size());
+    vector<exception_ptr> errors(queries.size());
+
+    vector<size_t> indexes(queries.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(execution::par, indexes.begin(), indexes.end(),
+            [&](size_t index) {
+                try {
+                    const vector<Document> documents =
+                            search_server.FindTopDocuments(queries[index]);
+                    copy(documents.begin(), documents.end(),
+                            buffer.begin() + index * max_count);
+                    counts[index] = documents.size();
+                } catch (...) {
+                    errors[index] = current_exception();
+                }
+            });
+    RethrowFirstError(errors);
+
+    // Сдвигаем результаты к началу буфера, убирая незаполненные участки
+    auto output = buffer.begin();
+    for (size_t index = 0; index < queries.size(); ++index) {
+        const auto slot = buffer.begin() + index * max_count;
+        output = move(slot, slot + counts[index], output);
+    }
+    buffer.erase(output, buffer.end());
+    return buffer;
+}
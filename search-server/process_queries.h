@@ -0,0 +1,24 @@
+#pragma once
+/*
+ * process_queries.h
+ *
+ *  Параллельная обработка пакета запросов к поисковому серверу.
+ */
+#include <string>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+// Результаты запросов в порядке следования запросов в пакете. Ошибка
+// запроса (invalid_argument) бросается в вызывающем потоке после обработки
+// всего пакета; если ошибочных запросов несколько — ошибка первого из них.
+std::vector<std::vector<Document>> ProcessQueries(
+        const SearchServer &search_server,
+        const std::vector<std::string> &queries);
+
+// Результаты всех запросов одним плоским вектором, в порядке запросов.
+// Промежуточный вектор векторов не создаётся: каждый запрос пишет свои
+// документы в заранее выделенный участок общего буфера. Ошибки — как
+// у ProcessQueries.
+std::vector<Document> ProcessQueriesJoined(const SearchServer &search_server,
+        const std::vector<std::string> &queries);
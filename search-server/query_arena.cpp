@@ -0,0 +1,57 @@
+/*
+ * query_arena.cpp
+ */
+#include "query_arena.h"
+#include <cstddef>
+
+using namespace std;
+
+namespace {
+
+// Первый блок арены; следующие вдвое больше предыдущего
+const size_t ARENA_INITIAL_BYTES = 16 * 1024;
+// Блоки до этого размера пул потока хранит между запросами
+const size_t ARENA_POOLED_BYTES = 4 * 1024 * 1024;
+
+struct ThreadArena {
+    pmr::unsynchronized_pool_resource blocks { pmr::pool_options { 0,
+            ARENA_POOLED_BYTES } };
+    pmr::monotonic_buffer_resource arena { ARENA_INITIAL_BYTES, &blocks };
+    pmr::memory_resource *caller_resource = nullptr;
+    int depth = 0;
+};
+
+ThreadArena& GetThreadArena() {
+    thread_local ThreadArena thread_arena;
+    return thread_arena;
+}
+
+}  // namespace
+
+QueryArena::QueryArena() {
+    ++GetThreadArena().depth;
+}
+
+QueryArena::~QueryArena() {
+    ThreadArena &thread_arena = GetThreadArena();
+    if (--thread_arena.depth == 0) {
+        thread_arena.arena.release();
+    }
+}
+
+pmr::memory_resource* QueryArena::Resource() const {
+    ThreadArena &thread_arena = GetThreadArena();
+    if (thread_arena.caller_resource != nullptr) {
+        return thread_arena.caller_resource;
+    }
+    return &thread_arena.arena;
+}
+
+QueryMemoryScope::QueryMemoryScope(pmr::memory_resource *resource) :
+        previous_(GetThreadArena().caller_resource) {
+    GetThreadArena().caller_resource = resource;
+}
+
+QueryMemoryScope::~QueryMemoryScope() {
+    GetThreadArena().caller_resource = previous_;
+}
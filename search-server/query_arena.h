@@ -0,0 +1,37 @@
+#pragma once
+/*
+ * query_arena.h
+ *
+ *  Память для временных данных запроса: разбор, накопитель релевантности,
+ *  исключаемые документы. По умолчанию это монотонная арена потока, которая
+ *  освобождается целиком после запроса; её блоки возвращаются в пул потока
+ *  и переиспользуются следующими запросами без обращений к malloc.
+ */
+#include <memory_resource>
+
+// Запрос в текущем потоке. Вложенные запросы (например, из предиката)
+// берут память из той же арены, она освобождается после внешнего запроса.
+class QueryArena {
+public:
+    QueryArena();
+    ~QueryArena();
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    std::pmr::memory_resource* Resource() const;
+};
+
+// Пока объект жив, запросы текущего потока берут временную память
+// у resource и не освобождают её. resource должен пережить объект.
+class QueryMemoryScope {
+public:
+    explicit QueryMemoryScope(std::pmr::memory_resource *resource);
+    ~QueryMemoryScope();
+
+    QueryMemoryScope(const QueryMemoryScope&) = delete;
+    QueryMemoryScope& operator=(const QueryMemoryScope&) = delete;
+
+private:
+    std::pmr::memory_resource *previous_;
+};
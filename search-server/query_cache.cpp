@@ -0,0 +1,73 @@
+/*
+ * query_cache.cpp
+ */
+#include "query_cache.h"
+
+using namespace std;
+
+QueryCache::QueryCache(size_t max_bytes) :
+        max_bytes_(max_bytes) {
+}
+
+optional<vector<Document>> QueryCache::Find(const string &key,
+        uint64_t generation) {
+    lock_guard guard(mutex_);
+    const auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++misses_;
+        return nullopt;
+    }
+    if (it->second->generation != generation) {
+        // Запись получена на другой версии индекса
+        Erase(it->second);
+        ++misses_;
+        return nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+void QueryCache::Insert(const string &key, uint64_t generation,
+        const vector<Document> &documents) {
+    const size_t bytes = EntryBytes(key, documents);
+    lock_guard guard(mutex_);
+    if (bytes > max_bytes_) {
+        return;
+    }
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+        Erase(it->second);
+    }
+    while (used_bytes_ + bytes > max_bytes_) {
+        Erase(prev(entries_.end()));
+    }
+    entries_.push_front( { key, generation, documents });
+    index_[key] = entries_.begin();
+    used_bytes_ += bytes;
+}
+
+void QueryCache::Clear() {
+    lock_guard guard(mutex_);
+    entries_.clear();
+    index_.clear();
+    used_bytes_ = 0;
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    lock_guard guard(mutex_);
+    return { hits_, misses_, entries_.size(), used_bytes_ };
+}
+
+size_t QueryCache::EntryBytes(const string &key,
+        const vector<Document> &documents) {
+    // Ключ хранится дважды (в списке и в хеш-таблице), плюс узлы контейнеров
+    const size_t overhead = sizeof(Entry) + 4 * sizeof(void*);
+    return overhead + 2 * key.size() + documents.size() * sizeof(Document);
+}
+
+void QueryCache::Erase(list<Entry>::iterator entry) {
+    used_bytes_ -= EntryBytes(entry->key, entry->documents);
+    index_.erase(entry->key);
+    entries_.erase(entry);
+}
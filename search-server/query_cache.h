@@ -0,0 +1,57 @@
+#pragma once
+/*
+ * query_cache.h
+ *
+ *  LRU-кэш результатов поиска. Ключ — нормализованный запрос, каждая запись
+ *  помечена поколением индекса, при котором она получена: после изменения
+ *  индекса поколение меняется и старые записи перестают находиться.
+ */
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+
+class QueryCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+        size_t used_bytes = 0;
+    };
+
+    // max_bytes — ограничение на примерный объём памяти, занятой записями
+    explicit QueryCache(size_t max_bytes);
+
+    std::optional<std::vector<Document>> Find(const std::string &key,
+            uint64_t generation);
+    void Insert(const std::string &key, uint64_t generation,
+            const std::vector<Document> &documents);
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    mutable std::mutex mutex_;
+    size_t max_bytes_;
+    size_t used_bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    // В начале списка — последние использованные записи
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+    static size_t EntryBytes(const std::string &key,
+            const std::vector<Document> &documents);
+    void Erase(std::list<Entry>::iterator entry);
+};
@@ -0,0 +1,85 @@
+/*
+ * query_executor.cpp
+ */
+#include "query_executor.h"
+#include <utility>
+
+using namespace std;
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t queue_limit) :
+        queue_limit_(queue_limit) {
+    if (thread_count == 0) {
+        throw invalid_argument("Пулу запросов нужен хотя бы один поток.");
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] {
+            Work();
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+        tasks_.clear();
+    }
+    has_tasks_.notify_all();
+    for (thread &worker : workers_) {
+        worker.join();
+    }
+}
+
+bool QueryExecutor::TrySubmit(function<void()> task) {
+    {
+        lock_guard guard(mutex_);
+        if (stopping_ || tasks_.size() >= queue_limit_) {
+            return false;
+        }
+        tasks_.push_back(move(task));
+    }
+    has_tasks_.notify_one();
+    return true;
+}
+
+size_t QueryExecutor::GetThreadCount() const {
+    return workers_.size();
+}
+
+size_t QueryExecutor::GetQueueLimit() const {
+    return queue_limit_;
+}
+
+void QueryExecutor::Work() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [this] {
+                return stopping_ || !tasks_.empty();
+            });
+            if (stopping_) {
+                return;
+            }
+            task = move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+QueryDeadline::QueryDeadline(Clock::time_point time) :
+        time_(time) {
+}
+
+bool QueryDeadline::Passed() {
+    if (!passed_ && Clock::now() >= time_) {
+        passed_ = true;
+    }
+    return passed_;
+}
+
+bool QueryDeadline::WasPassed() const {
+    return passed_;
+}
@@ -0,0 +1,67 @@
+#pragma once
+/*
+ * query_executor.h
+ *
+ *  Асинхронное выполнение запросов: пул потоков с ограниченной очередью и
+ *  срок выполнения запроса. Переполненная очередь сразу отклоняет задачу,
+ *  а запрос с истёкшим сроком прекращает подсчёт и отдаёт лучшее из
+ *  уже посчитанного.
+ */
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Задача не принята: очередь пула заполнена
+class QueryRejected: public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class QueryExecutor {
+public:
+    // queue_limit — сколько задач может ждать свободного потока
+    QueryExecutor(size_t thread_count, size_t queue_limit);
+    // Ожидающие задачи отбрасываются, выполняющиеся дорабатывают
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    // false, если очередь заполнена
+    bool TrySubmit(std::function<void()> task);
+    size_t GetThreadCount() const;
+    size_t GetQueueLimit() const;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<std::function<void()>> tasks_;
+    size_t queue_limit_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    void Work();
+};
+
+// Срок выполнения одного запроса; проверяется из потока запроса
+class QueryDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryDeadline(Clock::time_point time);
+
+    // Читает часы, пока срок не истёк; после этого сразу true
+    bool Passed();
+    // Истёк ли срок при одной из проверок
+    bool WasPassed() const;
+
+private:
+    Clock::time_point time_;
+    bool passed_ = false;
+};
@@ -0,0 +1,104 @@
+/*
+ * query_stats.cpp
+ */
+#include "query_stats.h"
+#include <algorithm>
+
+using namespace std;
+
+string_view QueryPhaseName(QueryPhase phase) {
+    switch (phase) {
+    case QueryPhase::PARSE:
+        return "parse"sv;
+    case QueryPhase::MINUS_WORDS:
+        return "minus_words"sv;
+    case QueryPhase::SCORING:
+        return "scoring"sv;
+    case QueryPhase::PREDICATE:
+        return "predicate"sv;
+    case QueryPhase::SORTING:
+        return "sorting"sv;
+    }
+    return "unknown"sv;
+}
+
+chrono::nanoseconds QueryStats::PhaseTime(QueryPhase phase) const {
+    return phase_time[static_cast<size_t>(phase)];
+}
+
+QueryStats& QueryStats::operator+=(const QueryStats &other) {
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        phase_time[phase] += other.phase_time[phase];
+    }
+    postings_scanned += other.postings_scanned;
+    candidates_scored += other.candidates_scored;
+    results_returned += other.results_returned;
+    return *this;
+}
+
+QueryStatsRecorder::QueryStatsRecorder(QueryStats &stats) :
+        stats_(stats) {
+    stats_ = QueryStats();
+}
+
+QueryStatsRecorder::~QueryStatsRecorder() {
+    if (measured_calls_ == 0 || sampled_calls_ == measured_calls_) {
+        return;
+    }
+    // Время несэмплированных вызовов досталось объемлющей фазе
+    const chrono::nanoseconds estimated = measured_time_
+            * static_cast<int64_t>(sampled_calls_ - measured_calls_)
+            / static_cast<int64_t>(measured_calls_);
+    if (sampled_parent_ == NO_PHASE) {
+        stats_.phase_time[sampled_phase_] += estimated;
+        return;
+    }
+    const chrono::nanoseconds moved = min(estimated,
+            stats_.phase_time[sampled_parent_]);
+    stats_.phase_time[sampled_phase_] += moved;
+    stats_.phase_time[sampled_parent_] -= moved;
+}
+
+QueryStatsRecorder::SampledPhase::SampledPhase(QueryStatsRecorder &recorder,
+        QueryPhase phase) :
+        recorder_(recorder), sampled_(
+                recorder.sampled_calls_++ % SAMPLE_PERIOD == 0) {
+    recorder_.sampled_phase_ = static_cast<size_t>(phase);
+    recorder_.sampled_parent_ = recorder_.current_;
+    if (sampled_) {
+        previous_ = recorder_.Switch(static_cast<size_t>(phase));
+    }
+}
+
+QueryStatsRecorder::SampledPhase::~SampledPhase() {
+    if (!sampled_) {
+        return;
+    }
+    const chrono::nanoseconds before =
+            recorder_.stats_.phase_time[recorder_.sampled_phase_];
+    recorder_.Switch(previous_);
+    recorder_.measured_time_ +=
+            recorder_.stats_.phase_time[recorder_.sampled_phase_] - before;
+    ++recorder_.measured_calls_;
+}
+
+QueryStatsRecorder::Phase::Phase(QueryStatsRecorder &recorder,
+        QueryPhase phase) :
+        recorder_(recorder), previous_(recorder.Switch(
+                static_cast<size_t>(phase))) {
+}
+
+QueryStatsRecorder::Phase::~Phase() {
+    recorder_.Switch(previous_);
+}
+
+size_t QueryStatsRecorder::Switch(size_t phase) {
+    const Clock::time_point now = Clock::now();
+    if (current_ != NO_PHASE) {
+        stats_.phase_time[current_] += now - last_switch_;
+    }
+    last_switch_ = now;
+    const size_t previous = current_;
+    current_ = phase;
+    return previous;
+}
@@ -0,0 +1,141 @@
+#pragma once
+/*
+ * query_stats.h
+ *
+ *  Статистика выполнения одного запроса: время по фазам и объём работы.
+ *  Сборщик выбирается параметром шаблона поиска. NoQueryStats ничего не
+ *  хранит и не читает часы, его вызовы исчезают при встраивании, поэтому
+ *  поиск без статистики стоит столько же, сколько раньше.
+ */
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class QueryPhase {
+    PARSE, MINUS_WORDS, SCORING, PREDICATE, SORTING
+};
+
+constexpr size_t QUERY_PHASE_COUNT = 5;
+
+// Имя фазы в метриках
+std::string_view QueryPhaseName(QueryPhase phase);
+
+struct QueryStats {
+    // Время фазы без вложенных в неё фаз: например, вызовы предиката
+    // не входят во время отбора лучших документов (SORTING)
+    std::array<std::chrono::nanoseconds, QUERY_PHASE_COUNT> phase_time { };
+    // Прочитанные вхождения плюс-слов
+    uint64_t postings_scanned = 0;
+    // Документы, для которых посчитана релевантность (для MatchDocument — 1)
+    uint64_t candidates_scored = 0;
+    // Документы выдачи или слова, найденные MatchDocument
+    uint64_t results_returned = 0;
+
+    std::chrono::nanoseconds PhaseTime(QueryPhase phase) const;
+    QueryStats& operator+=(const QueryStats &other);
+};
+
+class NoQueryStats {
+public:
+    class Phase {
+    public:
+        Phase(NoQueryStats&, QueryPhase) {
+        }
+    };
+    using SampledPhase = Phase;
+
+    void AddPostings(size_t) {
+    }
+    void AddCandidates(size_t) {
+    }
+    void SetResults(size_t) {
+    }
+};
+
+// Пишет статистику запроса в QueryStats, прежнее содержимое сбрасывается.
+// Каждое чтение часов относит прошедшее время к текущей фазе.
+class QueryStatsRecorder {
+public:
+    explicit QueryStatsRecorder(QueryStats &stats);
+    // Переносит оценку времени несэмплированных вызовов SampledPhase
+    ~QueryStatsRecorder();
+
+    QueryStatsRecorder(const QueryStatsRecorder&) = delete;
+    QueryStatsRecorder& operator=(const QueryStatsRecorder&) = delete;
+
+    // Фаза на время жизни объекта; после неё продолжается прежняя
+    class Phase {
+    public:
+        Phase(QueryStatsRecorder &recorder, QueryPhase phase);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        QueryStatsRecorder &recorder_;
+        size_t previous_;
+    };
+
+    // Фаза частых коротких вызовов (предикат на каждого кандидата): часы
+    // читаются на каждом SAMPLE_PERIOD-м вызове, время остальных оценивается
+    // по замеренным. Все вызовы запроса — одна фаза внутри одной и той же.
+    class SampledPhase {
+    public:
+        SampledPhase(QueryStatsRecorder &recorder, QueryPhase phase);
+        ~SampledPhase();
+
+        SampledPhase(const SampledPhase&) = delete;
+        SampledPhase& operator=(const SampledPhase&) = delete;
+
+    private:
+        QueryStatsRecorder &recorder_;
+        bool sampled_;
+        size_t previous_ = NO_PHASE;
+    };
+
+    void AddPostings(size_t count) {
+        stats_.postings_scanned += count;
+    }
+    void AddCandidates(size_t count) {
+        stats_.candidates_scored += count;
+    }
+    void SetResults(size_t count) {
+        stats_.results_returned = count;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    // Номер фазы; QUERY_PHASE_COUNT — вне фаз
+    static constexpr size_t NO_PHASE = QUERY_PHASE_COUNT;
+    static constexpr uint64_t SAMPLE_PERIOD = 16;
+
+    QueryStats &stats_;
+    size_t current_ = NO_PHASE;
+    Clock::time_point last_switch_;
+    // Вызовы SampledPhase: фаза, объемлющая фаза, число вызовов и замеров
+    size_t sampled_phase_ = NO_PHASE;
+    size_t sampled_parent_ = NO_PHASE;
+    uint64_t sampled_calls_ = 0;
+    uint64_t measured_calls_ = 0;
+    std::chrono::nanoseconds measured_time_ { 0 };
+
+    // Возвращает прежнюю фазу
+    size_t Switch(size_t phase);
+};
+
+// Вызов func, время которого относится к фазе phase
+template<typename Stats, typename Func>
+auto MeasurePhase(Stats &stats, QueryPhase phase, Func func) {
+    const typename Stats::Phase measured(stats, phase);
+    return func();
+}
+
+// То же для частых вызовов, время оценивается по выборке (SampledPhase)
+template<typename Stats, typename Func>
+auto MeasureSampledPhase(Stats &stats, QueryPhase phase, Func func) {
+    const typename Stats::SampledPhase measured(stats, phase);
+    return func();
+}
@@ -8,46 +8,240 @@
 #include "request_queue.h"
 #include "search_server.h"
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query,
+#include <algorithm>
+#include <sstream>
+
+RequestQueue::RequestQueue(const SearchServer &search_server) :
+        search_server_(search_server), time_source_([] {
+            return Clock::now();
+        }), buckets_(std::make_unique<MinuteBucket[]>(min_in_day_)) {
+}
+
+RequestQueue::RequestQueue(const SearchServer &search_server,
+        size_t cache_max_bytes) :
+        RequestQueue(search_server) {
+    cache_ = std::make_unique<QueryCache>(cache_max_bytes);
+}
+
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query,
         DocumentStatus status) {
-    const std::vector<Document> &v_res = search_server_.FindTopDocuments(
-            raw_query, status);
-    ProcessResultRequest(v_res);
-    return v_res;
+    return ProcessRequest([&](QueryStats *stats) {
+        if (stats) {
+            return cache_ ?
+                    search_server_.FindTopDocuments(raw_query, status, *cache_,
+                            *stats) :
+                    search_server_.FindTopDocuments(raw_query, status, *stats);
+        }
+        return cache_ ?
+                search_server_.FindTopDocuments(raw_query, status, *cache_) :
+                search_server_.FindTopDocuments(raw_query, status);
+    });
 }
 std::vector<Document> RequestQueue::AddFindRequest(
-        const std::string &raw_query) {
-    const std::vector<Document> &v_res = search_server_.FindTopDocuments(
-            raw_query);
-    ProcessResultRequest(v_res);
-    return v_res;
+        std::string_view raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 int RequestQueue::GetNoResultRequests() const {
-    return number_empty_requests_;
+    return static_cast<int>(Sum(min_in_day_,
+            [](const MinuteBucket &bucket, uint32_t minute) {
+                return bucket.empty_requests.Get(minute, minute);
+            }));
+}
+
+uint64_t RequestQueue::GetRequestCount() const {
+    return Sum(min_in_day_, [](const MinuteBucket &bucket, uint32_t minute) {
+        return bucket.requests.Get(minute, minute);
+    });
+}
+
+RequestQueue::LatencyHistogram RequestQueue::GetLatencyHistogram() const {
+    LatencyHistogram histogram;
+    for (int bin = 0; bin < latency_bins_; ++bin) {
+        histogram.counts[bin] = Sum(min_in_day_,
+                [bin](const MinuteBucket &bucket, uint32_t minute) {
+                    return bucket.latency[bin].Get(minute, minute);
+                });
+    }
+    return histogram;
+}
+
+double RequestQueue::GetQps(int minutes) const {
+    const int window = std::max(1, std::min(minutes, min_in_day_));
+    const uint64_t requests = Sum(window,
+            [](const MinuteBucket &bucket, uint32_t minute) {
+                return bucket.requests.Get(minute, minute);
+            });
+    return static_cast<double>(requests) / (window * 60.);
+}
+
+void RequestQueue::SetTimeSource(TimeSource time_source) {
+    time_source_ = std::move(time_source);
+}
+
+QueryCache::Stats RequestQueue::GetQueryCacheStats() const {
+    if (!cache_) {
+        return {};
+    }
+    return cache_->GetStats();
+}
+
+void RequestQueue::EnableQueryStats() {
+    if (!query_stats_) {
+        query_stats_ = std::make_unique<QueryStatsCounters>();
+    }
+}
+
+QueryStats RequestQueue::GetQueryStats() const {
+    QueryStats stats;
+    if (!query_stats_) {
+        return stats;
+    }
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        stats.phase_time[phase] = std::chrono::nanoseconds(
+                query_stats_->phase_ns[phase].load(std::memory_order_relaxed));
+    }
+    stats.postings_scanned = query_stats_->postings_scanned.load(
+            std::memory_order_relaxed);
+    stats.candidates_scored = query_stats_->candidates_scored.load(
+            std::memory_order_relaxed);
+    stats.results_returned = query_stats_->results_returned.load(
+            std::memory_order_relaxed);
+    return stats;
+}
+
+void RequestQueue::WritePrometheusMetrics(std::ostream &out) const {
+    // Метрика типа counter или gauge без меток
+    const auto write_metric = [](std::ostream &out, const char *name,
+            const char *type, const char *help, auto value) {
+        out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name
+                << ' ' << type << '\n' << name << ' ' << value << '\n';
+    };
+    std::ostringstream metrics;
+    metrics.precision(9);
+    write_metric(metrics, "search_requests_total", "counter",
+            "Search requests processed by the queue.",
+            total_requests_.load(std::memory_order_relaxed));
+    write_metric(metrics, "search_empty_requests_total", "counter",
+            "Search requests that returned no documents.",
+            total_empty_requests_.load(std::memory_order_relaxed));
+    write_metric(metrics, "search_requests_per_second", "gauge",
+            "Average request rate over the last minute.", GetQps(1));
+    if (query_stats_) {
+        const QueryStats stats = GetQueryStats();
+        metrics << "# HELP search_query_phase_seconds_total Time spent in each query phase.\n"
+                << "# TYPE search_query_phase_seconds_total counter\n";
+        for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+            metrics << "search_query_phase_seconds_total{phase=\""
+                    << QueryPhaseName(static_cast<QueryPhase>(phase))
+                    << "\"} "
+                    << std::chrono::duration<double>(stats.phase_time[phase]).count()
+                    << '\n';
+        }
+        write_metric(metrics, "search_postings_scanned_total", "counter",
+                "Postings read while scoring queries.", stats.postings_scanned);
+        write_metric(metrics, "search_candidates_scored_total", "counter",
+                "Documents whose relevance was computed.",
+                stats.candidates_scored);
+        write_metric(metrics, "search_results_returned_total", "counter",
+                "Documents returned to callers.", stats.results_returned);
+    }
+    out << metrics.str();
+}
+
+void RequestQueue::RecordQueryStats(const QueryStats &stats) {
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        query_stats_->phase_ns[phase].fetch_add(
+                static_cast<uint64_t>(stats.phase_time[phase].count()),
+                std::memory_order_relaxed);
+    }
+    query_stats_->postings_scanned.fetch_add(stats.postings_scanned,
+            std::memory_order_relaxed);
+    query_stats_->candidates_scored.fetch_add(stats.candidates_scored,
+            std::memory_order_relaxed);
+    query_stats_->results_returned.fetch_add(stats.results_returned,
+            std::memory_order_relaxed);
+}
+
+void RequestQueue::RecordRequest(bool empty, Clock::duration latency) {
+    total_requests_.fetch_add(1, std::memory_order_relaxed);
+    if (empty) {
+        total_empty_requests_.fetch_add(1, std::memory_order_relaxed);
+    }
+    const uint32_t minute = CurrentMinute();
+    MinuteBucket &bucket = buckets_[minute % min_in_day_];
+    bucket.requests.Increment(minute);
+    if (empty) {
+        bucket.empty_requests.Increment(minute);
+    }
+    const uint64_t latency_us = static_cast<uint64_t>(std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    int bin = 0;
+    while (bin + 1 < latency_bins_ && latency_us >= LatencyHistogram::UpperBoundUs(bin)) {
+        ++bin;
+    }
+    bucket.latency[bin].Increment(minute);
+}
+
+uint32_t RequestQueue::CurrentMinute() const {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::minutes>(
+            time_source_().time_since_epoch()).count());
 }
 
-void RequestQueue::ProcessResultRequest(const std::vector<Document> &v_res) {
-    QueryResult query_result;
-    if (v_res.empty()) {
-        query_result = { v_res, true };
-    } else {
-        query_result = { v_res, false };
+void RequestQueue::MinuteCounter::Increment(uint32_t minute) {
+    uint64_t old_value = value_.load(std::memory_order_relaxed);
+    while (true) {
+        const uint32_t counter_minute = static_cast<uint32_t>(old_value >> 32);
+        uint64_t new_value;
+        if (counter_minute == minute) {
+            new_value = old_value + 1;
+        } else if (counter_minute < minute) {
+            new_value = (static_cast<uint64_t>(minute) << 32) | 1;
+        } else {
+            // Ячейку уже заняла более поздняя минута — запрос устарел
+            return;
+        }
+        if (value_.compare_exchange_weak(old_value, new_value,
+                std::memory_order_relaxed)) {
+            return;
+        }
     }
-    Push(query_result);
 }
 
-void RequestQueue::Push(QueryResult query_result) {
-    if (min_in_day_ > current_number_requests_) {
-        requests_.push_back(query_result); // @suppress("Invalid arguments")
-        ++current_number_requests_; // добавляем количество минут
-    } else {
-        requests_.push_back(query_result); // @suppress("Invalid arguments")
-        if (requests_.front().request_empty) // @suppress("Field cannot be resolved")
-            --number_empty_requests_; // Уменьшаем количество пустых слов
-        requests_.pop_front();
+uint32_t RequestQueue::MinuteCounter::Get(uint32_t first_minute,
+        uint32_t last_minute) const {
+    const uint64_t value = value_.load(std::memory_order_relaxed);
+    const uint32_t counter_minute = static_cast<uint32_t>(value >> 32);
+    if (counter_minute < first_minute || counter_minute > last_minute) {
+        return 0;
     }
-    if (query_result.request_empty)
-        ++number_empty_requests_; // Увеличиваем количество пустых запросов
+    return static_cast<uint32_t>(value);
+}
 
+uint64_t RequestQueue::LatencyHistogram::UpperBoundUs(int bin) {
+    return uint64_t { 2 } << bin;
 }
 
+uint64_t RequestQueue::LatencyHistogram::Total() const {
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t RequestQueue::LatencyHistogram::PercentileUs(double rank) const {
+    const uint64_t total = Total();
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t target = std::max<uint64_t>(1,
+            static_cast<uint64_t>(rank * static_cast<double>(total) + 0.5));
+    uint64_t seen = 0;
+    for (int bin = 0; bin < latency_bins_; ++bin) {
+        seen += counts[bin];
+        if (seen >= target) {
+            return UpperBoundUs(bin);
+        }
+    }
+    return UpperBoundUs(latency_bins_ - 1);
+}
@@ -5,49 +5,157 @@
  *  Created on: 7 сент. 2024 г.
  *      Author: vitasan
  */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <deque>
+#include "query_cache.h"
+#include "query_stats.h"
 #include "search_server.h"
 
 #include "document.h"
 
+// Статистика запросов за последние сутки. Хранит не результаты, а счётчики
+// по минутам в кольцевом буфере на min_in_day_ ячеек. Счётчики обновляются
+// атомарно без блокировок, поэтому одну очередь могут использовать
+// несколько потоков одновременно.
 class RequestQueue {
 public:
+    using Clock = std::chrono::steady_clock;
+    // Источник текущего времени, по которому запрос относится к минуте
+    using TimeSource = std::function<Clock::time_point()>;
 
-    explicit RequestQueue(const SearchServer &search_server) :
-            search_server_(search_server) {
-    }
+    // Корзина i гистограммы задержек — меньше 2^(i+1) мкс, последняя — всё остальное
+    static constexpr int latency_bins_ = 20;
+
+    struct LatencyHistogram {
+        std::array<uint64_t, latency_bins_> counts { };
+
+        static uint64_t UpperBoundUs(int bin);
+        uint64_t Total() const;
+        // Оценка перцентиля сверху (граница корзины), rank из [0, 1]
+        uint64_t PercentileUs(double rank) const;
+    };
+
+    explicit RequestQueue(const SearchServer &search_server);
+    // Очередь со своим кэшем результатов поиска по статусу объёмом cache_max_bytes
+    RequestQueue(const SearchServer &search_server, size_t cache_max_bytes);
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template<typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string &raw_query,
+    std::vector<Document> AddFindRequest(std::string_view raw_query,
             DocumentPredicate document_predicate);
-    std::vector<Document> AddFindRequest(const std::string &raw_query,
+    std::vector<Document> AddFindRequest(std::string_view raw_query,
             DocumentStatus status);
-    std::vector<Document> AddFindRequest(const std::string &raw_query);
+    std::vector<Document> AddFindRequest(std::string_view raw_query);
+    // Счётчики за последние сутки, включая текущую минуту
     int GetNoResultRequests() const;
+    uint64_t GetRequestCount() const;
+    LatencyHistogram GetLatencyHistogram() const;
+    // Среднее число запросов в секунду за последние minutes минут
+    double GetQps(int minutes = 1) const;
+    // Подменяет часы (например, в тестах); вызывать до начала работы с очередью
+    void SetTimeSource(TimeSource time_source);
+    // Статистика кэша очереди; без кэша — нулевая
+    QueryCache::Stats GetQueryCacheStats() const;
+    // Включает сбор статистики выполнения запросов (query_stats.h);
+    // вызывать до начала работы с очередью
+    void EnableQueryStats();
+    // Сумма статистики запросов с момента включения сбора
+    QueryStats GetQueryStats() const;
+    // Счётчики очереди в текстовом формате Prometheus
+    void WritePrometheusMetrics(std::ostream &out) const;
     const SearchServer &search_server_;
 private:
-    struct QueryResult {
-        std::vector<Document> query;
-        bool request_empty;
+    // Счётчик, привязанный к минуте: старшие 32 бита — номер минуты,
+    // младшие — значение. Запись за новую минуту обнуляет значение тем же
+    // атомарным обменом, поэтому сброс ячейки не теряет параллельные запросы.
+    class MinuteCounter {
+    public:
+        void Increment(uint32_t minute);
+        // Значение, если счётчик относится к минуте из [first_minute, last_minute]
+        uint32_t Get(uint32_t first_minute, uint32_t last_minute) const;
+    private:
+        std::atomic<uint64_t> value_ { 0 };
+    };
+
+    struct MinuteBucket {
+        MinuteCounter requests;
+        MinuteCounter empty_requests;
+        std::array<MinuteCounter, latency_bins_> latency;
     };
-    void ProcessResultRequest(const std::vector<Document> &v_res);
 
-    void Push(QueryResult query_result);
+    // Накопленная статистика запросов; пишется из нескольких потоков
+    struct QueryStatsCounters {
+        std::array<std::atomic<uint64_t>, QUERY_PHASE_COUNT> phase_ns { };
+        std::atomic<uint64_t> postings_scanned { 0 };
+        std::atomic<uint64_t> candidates_scored { 0 };
+        std::atomic<uint64_t> results_returned { 0 };
+    };
 
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
-    int current_number_requests_ = 0;
-    int number_empty_requests_ = 0;
+    // search(QueryStats*) выполняет запрос; указатель пустой, если
+    // статистика не собирается
+    template<typename Search>
+    std::vector<Document> ProcessRequest(Search search);
+    void RecordRequest(bool empty, Clock::duration latency);
+    void RecordQueryStats(const QueryStats &stats);
+    uint32_t CurrentMinute() const;
+    // Сумма счётчика counter по ячейкам последних minutes минут
+    template<typename Counter>
+    uint64_t Sum(int minutes, Counter counter) const;
 
+    std::unique_ptr<QueryCache> cache_;
+    TimeSource time_source_;
+    static constexpr int min_in_day_ = 1440;
+    std::unique_ptr<MinuteBucket[]> buckets_;
+    // Счётчики с момента создания очереди, для метрик
+    std::atomic<uint64_t> total_requests_ { 0 };
+    std::atomic<uint64_t> total_empty_requests_ { 0 };
+    std::unique_ptr<QueryStatsCounters> query_stats_;
 };
 
 template<typename DocumentPredicate>
-std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query,
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query,
         DocumentPredicate document_predicate) {
-    const std::vector<Document> &v_res = search_server_.FindTopDocuments(
-            raw_query, document_predicate);
-    ProcessResultRequest(v_res);
+    return ProcessRequest([&](QueryStats *stats) {
+        return stats ?
+                search_server_.FindTopDocuments(raw_query, document_predicate,
+                        *stats) :
+                search_server_.FindTopDocuments(raw_query, document_predicate);
+    });
+}
+
+template<typename Search>
+std::vector<Document> RequestQueue::ProcessRequest(Search search) {
+    const Clock::time_point start = Clock::now();
+    QueryStats stats;
+    std::vector<Document> v_res = search(query_stats_ ? &stats : nullptr);
+    RecordRequest(v_res.empty(), Clock::now() - start);
+    if (query_stats_) {
+        RecordQueryStats(stats);
+    }
     return v_res;
 }
+
+template<typename Counter>
+uint64_t RequestQueue::Sum(int minutes, Counter counter) const {
+    const uint32_t last_minute = CurrentMinute();
+    const int window = std::max(1, std::min(minutes, min_in_day_));
+    const uint32_t first_minute =
+            last_minute >= static_cast<uint32_t>(window - 1) ?
+                    last_minute - (window - 1) : 0;
+    uint64_t sum = 0;
+    for (uint32_t minute = first_minute;; ++minute) {
+        const MinuteBucket &bucket = buckets_[minute % min_in_day_];
+        sum += counter(bucket, minute);
+        if (minute == last_minute) {
+            break;
+        }
+    }
+    return sum;
+}
@@ -0,0 +1,47 @@
+/*
+ * score_accumulator.cpp
+ */
+#include "score_accumulator.h"
+
+using namespace std;
+
+namespace {
+
+DenseScores::Buffer& GetThreadBuffer() {
+    thread_local DenseScores::Buffer buffer;
+    return buffer;
+}
+
+}  // namespace
+
+SparseScores::SparseScores(size_t max_documents,
+        pmr::memory_resource *resource) :
+        slots_(resource) {
+    // Заполнено не больше половины ячеек
+    size_t slot_count = 16;
+    while (slot_count < max_documents * 2) {
+        slot_count *= 2;
+    }
+    slots_.resize(slot_count);
+    mask_ = slot_count - 1;
+}
+
+bool DenseScores::IsAvailable() {
+    return !GetThreadBuffer().busy;
+}
+
+DenseScores::DenseScores(size_t window_size) :
+        buffer_(GetThreadBuffer()) {
+    buffer_.busy = true;
+    if (buffer_.scores.size() < window_size) {
+        buffer_.scores.resize(window_size, UNTOUCHED);
+    }
+}
+
+DenseScores::~DenseScores() {
+    for (uint32_t index : buffer_.touched) {
+        buffer_.scores[index] = UNTOUCHED;
+    }
+    buffer_.touched.clear();
+    buffer_.busy = false;
+}
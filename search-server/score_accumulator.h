@@ -0,0 +1,106 @@
+#pragma once
+/*
+ * score_accumulator.h
+ *
+ *  Накопители релевантности кандидатов при полном подсчёте. Вклад слова
+ *  прибавляется к сумме документа; первый вклад заводит документ,
+ *  даже если он нулевой.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "document_table.h"
+
+// Хеш-таблица документ -> релевантность на известное заранее наибольшее
+// число документов, без перестроений. Память берётся у resource.
+class SparseScores {
+public:
+    SparseScores(size_t max_documents, std::pmr::memory_resource *resource);
+
+    void Add(int document_id, double score) {
+        for (size_t index = DocumentTable::Hash(document_id) & mask_;;
+                index = (index + 1) & mask_) {
+            Slot &slot = slots_[index];
+            if (slot.document_id == document_id) {
+                slot.score += score;
+                return;
+            }
+            if (slot.document_id == EMPTY) {
+                slot = { document_id, score };
+                return;
+            }
+        }
+    }
+
+    // func(document_id, relevance) для каждого документа
+    template<typename Func>
+    void ForEach(Func func) const {
+        for (const Slot &slot : slots_) {
+            if (slot.document_id != EMPTY) {
+                func(slot.document_id, slot.score);
+            }
+        }
+    }
+
+private:
+    static constexpr int EMPTY = -1;
+
+    struct Slot {
+        int document_id = EMPTY;
+        double score = 0.;
+    };
+
+    std::pmr::vector<Slot> slots_;
+    size_t mask_ = 0;
+};
+
+// Плотный массив релевантности по смещениям идентификаторов документов
+// от начала окна. Массив у каждого потока свой и переиспользуется окнами
+// и запросами: после окна сбрасываются только затронутые ячейки из списка.
+// Окно не длиннее MAX_DOCUMENTS, так что поток держит не больше 8 МБ.
+class DenseScores {
+public:
+    static constexpr size_t MAX_DOCUMENTS = size_t(1) << 20;
+
+    // false, если массив потока занят: запрос вызван из предиката
+    // другого запроса
+    static bool IsAvailable();
+
+    // window_size не больше MAX_DOCUMENTS
+    explicit DenseScores(size_t window_size);
+    ~DenseScores();
+
+    DenseScores(const DenseScores&) = delete;
+    DenseScores& operator=(const DenseScores&) = delete;
+
+    void Add(uint32_t index, double score) {
+        double &total = buffer_.scores[index];
+        if (total == UNTOUCHED) {
+            total = score;
+            buffer_.touched.push_back(index);
+        } else {
+            total += score;
+        }
+    }
+
+    // func(index, relevance) в порядке первого вклада
+    template<typename Func>
+    void ForEach(Func func) const {
+        for (uint32_t index : buffer_.touched) {
+            func(index, buffer_.scores[index]);
+        }
+    }
+
+    struct Buffer {
+        std::vector<double> scores;
+        std::vector<uint32_t> touched;
+        bool busy = false;
+    };
+
+private:
+    // Вклады не бывают отрицательными
+    static constexpr double UNTOUCHED = -1.;
+
+    Buffer &buffer_;
+};
@@ -14,6 +14,17 @@
 #include <cmath>
 #include <set>
 #include <stdexcept>
+#include <string_view>
+#include <cstdio>
+#include <limits>
+#include <atomic>
+#include <unordered_map>
+#include <exception>
+#include <utility>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -22,6 +33,10 @@ SearchServer::SearchServer() {
 ;
 
 SearchServer::SearchServer(const std::string &stop_words_text) :
+        SearchServer(string_view(stop_words_text)) {
+}
+
+SearchServer::SearchServer(string_view stop_words_text) :
         SearchServer(SplitIntoWords(stop_words_text)) {
 }
 
@@ -30,119 +45,475 @@ int SearchServer::GetDocumentCount() const {
     return document_count_;
 }
 
-vector<string> SearchServer::SplitIntoWords(const string &text) const {
-    vector<string> words;
-    string word;
-    for (const char c : text) {
-        if (c == ' ') {
-            if (!word.empty()) {
-                if (!IsValidString(word)) {
-                    throw invalid_argument(
-                            "Слово `"s + word
-                                    + "` имеет запрещенные символы."s);
-                }
-                words.push_back(word);
-                word.clear();
-            }
-        } else {
-            word += c;
-        }
-    }
+void SearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+    generation_ = NextGeneration();
+}
 
-    if (!word.empty()) {
-        words.push_back(word);
-    }
+size_t SearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
 
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+vector<string_view> SearchServer::SplitIntoWords(string_view text) const {
+    vector<string_view> words;
+    ForEachWord(text, [&words](string_view word) {
+        words.push_back(word);
+    });
     return words;
 }
 
-void SearchServer::AddDocument(int document_id, const string &document,
+void SearchServer::AddDocument(int document_id, string_view document,
         DocumentStatus status, const vector<int> &rating) {
 
+    DetachSnapshot();
     PossibleAddDocument(document_id, document);
+    generation_ = NextGeneration();
+
+    // Сначала считаем частоты внутри документа, чтобы в каждый список
+    // вхождений документ попал ровно один раз
+    WordCounts word_counts = CountWords(document);
+    // Новые термины получают идентификаторы больше всех прежних и в порядке
+    // добавления, поэтому список терминов остаётся упорядоченным
+    for (const auto& [word, count] : word_counts.new_words) {
+        word_counts.terms.emplace_back(AddTerm(word), count);
+    }
+    auto document_terms = make_shared<DocumentTerms>();
+    document_terms->term_ids.reserve(word_counts.terms.size());
+    document_terms->term_freqs.reserve(word_counts.terms.size());
+    for (const auto& [term_id, count] : word_counts.terms) {
+        MutablePostings(term_postings_.Mutable(term_id)).Add( { document_id,
+                count, word_counts.length });
+        document_terms->term_ids.push_back(term_id);
+        document_terms->term_freqs.push_back(
+                static_cast<double>(count) / word_counts.length);
+    }
+    documents_.Add(document_id, ComputeAverageRating(rating), status,
+            move(document_terms));
+    UpdateDocumentCount(1);
+}
+
+void SearchServer::AddDocuments(const vector<DocumentToAdd> &documents) {
+    DetachSnapshot();
+
+    // Словарь при разборе не меняется: у нового слова вместо идентификатора
+    // термина — номер среди новых слов части с флагом NEW_WORD
+    static constexpr uint32_t NEW_WORD = uint32_t(1) << 31;
+    // Частичный индекс части пакета: прямой индекс её документов лежит
+    // в document_terms, здесь — новые слова части, каждое один раз. Пока
+    // вхождения не записаны в списки, term_freqs хранят числа вхождений.
+    struct PartialIndex {
+        size_t begin = 0;
+        size_t end = 0;
+        vector<string_view> new_words;
+    };
+    vector<exception_ptr> errors(documents.size());
+    vector<uint32_t> lengths(documents.size());
+    vector<shared_ptr<DocumentTerms>> document_terms(documents.size());
+    vector<PartialIndex> partial_indexes;
+    for (size_t begin = 0; begin < documents.size(); begin +=
+            BULK_DOCUMENTS_CHUNK) {
+        PartialIndex &partial = partial_indexes.emplace_back();
+        partial.begin = begin;
+        partial.end = min(documents.size(), begin + BULK_DOCUMENTS_CHUNK);
+    }
+    for_each(execution::par, partial_indexes.begin(), partial_indexes.end(),
+            [&](PartialIndex &partial) {
+                unordered_map<string_view, uint32_t> new_word_indexes;
+                vector<uint32_t> term_ids;
+                for (size_t i = partial.begin; i < partial.end; ++i) {
+                    // Исключение из параллельного алгоритма завершило бы
+                    // программу, поэтому оно сохраняется до проверки пакета
+                    try {
+                        term_ids.clear();
+                        ForEachWord(documents[i].text, [&](string_view word) {
+                            term_ids.push_back(
+                                    FindBatchTerm(word, NEW_WORD,
+                                            new_word_indexes,
+                                            partial.new_words));
+                        });
+                    } catch (...) {
+                        errors[i] = current_exception();
+                        continue;
+                    }
+                    term_ids.erase(
+                            remove(term_ids.begin(), term_ids.end(),
+                                    TermDictionary::NO_TERM), term_ids.end());
+                    lengths[i] = static_cast<uint32_t>(term_ids.size());
+                    sort(term_ids.begin(), term_ids.end());
+                    size_t unique_count = 0;
+                    for (size_t j = 0; j < term_ids.size(); ++j) {
+                        unique_count += j == 0 || term_ids[j] != term_ids[j - 1];
+                    }
+                    auto terms = make_shared<DocumentTerms>();
+                    terms->term_ids.reserve(unique_count);
+                    terms->term_freqs.reserve(unique_count);
+                    for (size_t j = 0; j < term_ids.size(); ++j) {
+                        if (j > 0 && term_ids[j] == term_ids[j - 1]) {
+                            terms->term_freqs.back() += 1.;
+                        } else {
+                            terms->term_ids.push_back(term_ids[j]);
+                            terms->term_freqs.push_back(1.);
+                        }
+                    }
+                    document_terms[i] = move(terms);
+                }
+            });
+
+    // Порядок документов по идентификаторам: по нему вхождения пишутся
+    // в списки, в нём же повторы идентификаторов стоят рядом
+    vector<size_t> order(documents.size());
+    iota(order.begin(), order.end(), 0);
+    const auto by_id = [&documents](size_t lhs, size_t rhs) {
+        return documents[lhs].id < documents[rhs].id;
+    };
+    if (!is_sorted(order.begin(), order.end(), by_id)) {
+        stable_sort(order.begin(), order.end(), by_id);
+    }
+    vector<bool> pending(documents.size());
+    for (size_t j = 1; j < order.size(); ++j) {
+        pending[order[j]] = documents[order[j]].id
+                == documents[order[j - 1]].id;
+    }
+    // Проверки в порядке пакета, как при последовательных вызовах AddDocument
+    for (size_t i = 0; i < documents.size(); ++i) {
+        PossibleAddDocument(documents[i].id, documents[i].text, pending[i]);
+        if (errors[i]) {
+            rethrow_exception(errors[i]);
+        }
+    }
+    if (documents.empty()) {
+        return;
+    }
+    generation_ = NextGeneration();
+
+    // Новые слова попадают в словарь по разу на часть. Их идентификаторы
+    // больше прежних, поэтому у документа упорядочиваются только они.
+    for (PartialIndex &partial : partial_indexes) {
+        vector<uint32_t> new_term_ids;
+        new_term_ids.reserve(partial.new_words.size());
+        for (string_view word : partial.new_words) {
+            new_term_ids.push_back(AddTerm(word));
+        }
+        for (size_t i = partial.begin; i < partial.end; ++i) {
+            DocumentTerms &terms = *document_terms[i];
+            const size_t first_new = static_cast<size_t>(lower_bound(
+                    terms.term_ids.begin(), terms.term_ids.end(), NEW_WORD)
+                    - terms.term_ids.begin());
+            if (first_new == terms.term_ids.size()) {
+                continue;
+            }
+            vector<pair<uint32_t, double>> new_terms;
+            new_terms.reserve(terms.term_ids.size() - first_new);
+            for (size_t j = first_new; j < terms.term_ids.size(); ++j) {
+                new_terms.emplace_back(
+                        new_term_ids[terms.term_ids[j] & ~NEW_WORD],
+                        terms.term_freqs[j]);
+            }
+            sort(new_terms.begin(), new_terms.end());
+            for (size_t j = 0; j < new_terms.size(); ++j) {
+                terms.term_ids[first_new + j] = new_terms[j].first;
+                terms.term_freqs[first_new + j] = new_terms[j].second;
+            }
+        }
+    }
+
+    // Вхождения дописываются в списки по возрастанию идентификаторов
+    // документов, то есть обычно прямо в несжатый хвост
+    vector<PostingList*> postings(terms_.Size(), nullptr);
+    for (size_t i : order) {
+        DocumentTerms &terms = *document_terms[i];
+        for (size_t j = 0; j < terms.term_ids.size(); ++j) {
+            const uint32_t term_id = terms.term_ids[j];
+            if (postings[term_id] == nullptr) {
+                postings[term_id] = &MutablePostings(
+                        term_postings_.Mutable(term_id));
+            }
+            postings[term_id]->Add( { documents[i].id,
+                    static_cast<uint32_t>(terms.term_freqs[j]), lengths[i] });
+            terms.term_freqs[j] /= lengths[i];
+        }
+    }
+
+    documents_.Reserve(documents_.OrdinalCount() + documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentToAdd &document = documents[i];
+        documents_.Add(document.id, ComputeAverageRating(document.ratings),
+                document.status, move(document_terms[i]));
+    }
+    UpdateDocumentCount(static_cast<int>(documents.size()));
+}
 
-    const vector<string> words = SplitIntoWordsNoStop(document);
-    int count_words = words.size();
-    double frequency_occurrence_word = 1. / count_words;
-    for (const string &word : words) {
-        word_to_document_freqs_[word][document_id] += frequency_occurrence_word;
+uint32_t SearchServer::FindBatchTerm(string_view word, uint32_t new_word_flag,
+        unordered_map<string_view, uint32_t> &new_word_indexes,
+        vector<string_view> &new_words) const {
+    const uint32_t term_id = terms_.Find(word);
+    if (term_id != TermDictionary::NO_TERM) {
+        return terms_.IsStopWord(term_id) ? TermDictionary::NO_TERM : term_id;
+    }
+    const auto [it, inserted] = new_word_indexes.emplace(word,
+            new_word_flag | static_cast<uint32_t>(new_words.size()));
+    if (inserted) {
+        new_words.push_back(word);
     }
-    properties_documents_[document_id] =
-            { ComputeAverageRating(rating), status };
-    insert_doc_.push_back(document_id);
-    ++document_count_;
+    return it->second;
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string &raw_query) const {
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string &raw_query,
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
         DocumentStatus find_status) const {
+    if (query_cache_) {
+        NoQueryStats stats;
+        return FindTopDocumentsCached(execution::seq, raw_query, find_status,
+                *query_cache_, stats);
+    }
     return FindTopDocuments(raw_query,
             [&find_status](int document_id, DocumentStatus status, int rating) {
                 return status == find_status;
             });
 }
 
-tuple<vector<string>, DocumentStatus> SearchServer::MatchDocument(
-        const string &raw_query, int document_id) const {
-    Query query;
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
+        DocumentStatus find_status, QueryCache &cache) const {
+    NoQueryStats stats;
+    return FindTopDocumentsCached(execution::seq, raw_query, find_status,
+            cache, stats);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
+        DocumentStatus find_status, QueryStats &stats) const {
+    QueryStatsRecorder recorder(stats);
+    if (query_cache_) {
+        return FindTopDocumentsCached(execution::seq, raw_query, find_status,
+                *query_cache_, recorder);
+    }
+    return FindTopDocumentsWithStats(raw_query,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            }, recorder);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
+        DocumentStatus find_status, QueryCache &cache,
+        QueryStats &stats) const {
+    QueryStatsRecorder recorder(stats);
+    return FindTopDocumentsCached(execution::seq, raw_query, find_status,
+            cache, recorder);
+}
+
+vector<Document> SearchServer::FindTopDocumentsAfter(string_view raw_query,
+        const SearchAfter &after, DocumentStatus find_status) const {
+    return FindTopDocumentsAfter(raw_query, after,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            });
+}
+
+void SearchServer::EnableAsyncQueries(size_t thread_count,
+        size_t queue_limit) {
+    query_executor_ = make_shared<QueryExecutor>(thread_count, queue_limit);
+}
+
+future<SearchServer::SearchResult> SearchServer::FindTopDocumentsAsync(
+        string_view raw_query, DocumentStatus find_status,
+        chrono::steady_clock::duration timeout) const {
+    return FindTopDocumentsAsync(raw_query,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            }, timeout);
+}
+
+future<SearchServer::SearchResult> SearchServer::FindTopDocumentsAsync(
+        string_view raw_query, chrono::steady_clock::duration timeout) const {
+    return FindTopDocumentsAsync(raw_query, DocumentStatus::ACTUAL, timeout);
+}
 
-    ParseQuery(raw_query, query);
-    CheckQurey(query);
+void SearchServer::EnableQueryCache(size_t max_bytes) {
+    query_cache_ = make_shared<QueryCache>(max_bytes);
+}
 
-    vector<string> v_result;
-    DocumentStatus doc_stat = DocumentStatus::ACTUAL;
+void SearchServer::DisableQueryCache() {
+    query_cache_.reset();
+}
 
-    auto interator = properties_documents_.find(document_id);
-    if (interator != properties_documents_.end()) {
-        doc_stat = interator->second.status; // @suppress("Field cannot be resolved")
+QueryCache::Stats SearchServer::GetQueryCacheStats() const {
+    if (!query_cache_) {
+        return {};
     }
+    return query_cache_->GetStats();
+}
 
-    if (query.minus_words.size() != 0) {
-        for (const string &minus_word : query.minus_words) {
-            auto map_word = word_to_document_freqs_.find(minus_word);
-            if (map_word != word_to_document_freqs_.end()) {
-                auto map_doc_id = map_word->second.find(document_id);
-                if (map_doc_id != map_word->second.end()) {
-                    return tuple(v_result, doc_stat);
-                }
-            }
-        }
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+uint64_t SearchServer::NextGeneration() {
+    static atomic<uint64_t> next_generation { 1 };
+    return next_generation.fetch_add(1, memory_order_relaxed);
+}
+
+string SearchServer::MakeQueryCacheKey(const Query &query,
+        DocumentStatus status) {
+    // Управляющие символы не встречаются в словах, поэтому годятся как разделители
+    pmr::vector<string_view> minus_words(query.minus_words,
+            query.minus_words.get_allocator());
+    sort(minus_words.begin(), minus_words.end());
+    minus_words.erase(unique(minus_words.begin(), minus_words.end()),
+            minus_words.end());
+    string key;
+    for (string_view word : query.plus_words) {
+        key += word;
+        key += ' ';
+    }
+    key += '\x01';
+    for (string_view word : minus_words) {
+        key += word;
+        key += ' ';
     }
+    key += '\x01';
+    key += to_string(static_cast<int>(status));
+    return key;
+}
 
-    if (query.plus_words.size() != 0) {
-        for (const string &plus_word : query.plus_words) {
-            auto map_word = word_to_document_freqs_.find(plus_word);
-            if (map_word != word_to_document_freqs_.end()) {
-                auto map_doc_id = map_word->second.find(document_id);
-                if (map_doc_id != map_word->second.end()) {
-                    v_result.push_back(plus_word);
-                }
-            }
-        }
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
+        string_view raw_query, int document_id) const {
+    NoQueryStats stats;
+    return MatchDocumentWithStats(raw_query, document_id, stats);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
+        string_view raw_query, int document_id, QueryStats &stats) const {
+    QueryStatsRecorder recorder(stats);
+    return MatchDocumentWithStats(raw_query, document_id, recorder);
+}
+
+template<typename Stats>
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocumentWithStats(
+        string_view raw_query, int document_id, Stats &stats) const {
+    const QueryArena arena;
+    Query query(arena.Resource());
+    {
+        const typename Stats::Phase phase(stats, QueryPhase::PARSE);
+        ParseQuery(raw_query, query);
+        CheckQurey(query);
+    }
+
+    vector<string_view> v_result;
+    const DocumentStatus doc_stat = GetPropertiesDocument(document_id).status;
+    const ForwardTerms terms = GetForwardTerms(document_id);
+    stats.AddCandidates(1);
+
+    const bool excluded = MeasurePhase(stats, QueryPhase::MINUS_WORDS, [&] {
+        return any_of(query.minus_words.begin(), query.minus_words.end(),
+                [&terms](string_view minus_word) {
+                    return !terms.Find(minus_word).empty();
+                });
+    });
+    if (!excluded) {
+        const typename Stats::Phase phase(stats, QueryPhase::SCORING);
+        terms.Match(query.plus_words, v_result);
     }
-    sort(v_result.begin(), v_result.end());
+    stats.SetResults(v_result.size());
     return tuple(v_result, doc_stat);
 }
 
 int SearchServer::GetDocumentId(int index) const {
 
-    if (index < 0 || index >= static_cast<int>(insert_doc_.size())) {
+    if (index < 0 || index >= document_count_) {
         throw out_of_range(
                 "Значение индекса документа выходит за пределы допустимого диапазона."s);
     }
 
-    return insert_doc_.at(index);
+    if (snapshot_) {
+        return snapshot_->InsertOrder(index);
+    }
+    return documents_.Id(documents_.OrdinalAt(index));
+}
+
+const map<string_view, double>& SearchServer::GetWordFrequencies(
+        int document_id) const {
+    if (snapshot_) {
+        return snapshot_->WordFrequencies(document_id);
+    }
+    static const map<string_view, double> empty_word_freqs;
+    const DocumentTerms *found_terms = FindDocumentTerms(document_id);
+    if (found_terms == nullptr) {
+        return empty_word_freqs;
+    }
+    const DocumentTerms &document_terms = *found_terms;
+    // Строки терминов не перемещаются, поэтому словарь документа годится
+    // и для копий сервера
+    call_once(document_terms.word_freqs_built, [this, &document_terms]() {
+        for (size_t i = 0; i < document_terms.term_ids.size(); ++i) {
+            document_terms.word_freqs.emplace(
+                    terms_.Term(document_terms.term_ids[i]),
+                    document_terms.term_freqs[i]);
+        }
+    });
+    return document_terms.word_freqs;
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+    DetachSnapshot();
+    generation_ = NextGeneration();
+    const DocumentTerms *document_terms = FindDocumentTerms(document_id);
+    if (document_terms == nullptr) {
+        return;
+    }
+    for (PostingList *postings : GetDocumentPostings(*document_terms)) {
+        postings->Remove(document_id);
+    }
+    EraseDocumentProperties(document_id);
+}
+
+vector<SearchServer::PostingList*> SearchServer::GetDocumentPostings(
+        const DocumentTerms &document_terms) {
+    vector<PostingList*> postings;
+    postings.reserve(document_terms.term_ids.size());
+    for (uint32_t term_id : document_terms.term_ids) {
+        postings.push_back(&MutablePostings(term_postings_.Mutable(term_id)));
+    }
+    return postings;
+}
+
+const DocumentTerms* SearchServer::FindDocumentTerms(int document_id) const {
+    const uint32_t ordinal = documents_.Find(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        return nullptr;
+    }
+    return documents_.Terms(ordinal).get();
+}
+
+void SearchServer::EraseDocumentProperties(int document_id) {
+    documents_.Remove(document_id);
+    UpdateDocumentCount(-1);
 }
 
 SearchServer::DocumentProperties SearchServer::GetPropertiesDocument(
         const int &id) const {
     DocumentProperties doc_result;
-    const auto &interator = properties_documents_.find(id);
-    if (interator != properties_documents_.end()) {
-        return interator->second;
+    if (snapshot_) {
+        const SnapshotDocumentEntry *document = snapshot_->FindDocument(id);
+        if (document != nullptr) {
+            doc_result.rating = document->rating;
+            doc_result.status = static_cast<DocumentStatus>(document->status);
+        }
+        return doc_result;
+    }
+    const uint32_t ordinal = documents_.Find(id);
+    if (ordinal != DocumentTable::NO_DOCUMENT) {
+        doc_result.rating = documents_.Rating(ordinal);
+        doc_result.status = documents_.Status(ordinal);
     }
     return doc_result;
 }
@@ -156,41 +527,24 @@ int SearchServer::ComputeAverageRating(const vector<int> &ratings) {
     return sum / rating;
 }
 
-bool SearchServer::IsStopWord(const string &word) const {
-    if (stop_words_.size() != 0) {
-        return stop_words_.count(word) > 0;
-    }
-    return false;
+bool SearchServer::IsStopWord(string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id != TermDictionary::NO_TERM && terms_.IsStopWord(term_id);
 }
 
-vector<string> SearchServer::SplitIntoWordsNoStop(const string &text) const {
-    vector<string> words;
-
-    for (const string &word : SplitIntoWords(text)) {
-        if (!IsValidString(word)) {
-            throw invalid_argument(
-                    "Текст `"s + text + "` содержит запрещенные символы."s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
-    }
-    return words;
-}
-
-bool SearchServer::IsValidString(const string &str) {
+bool SearchServer::IsValidString(string_view str) {
     return none_of(str.begin(), str.end(), [](char c) {
         return c >= '\0' && c < ' ';
     });
 }
 
-void SearchServer::PossibleAddDocument(int document_id,
-        const string &document) const {
+void SearchServer::PossibleAddDocument(int document_id, string_view document,
+        bool pending) const {
     if (document_id < 0) // id документа не может быть меньше нуля
         throw invalid_argument(
-                "Идентификатор документа `"s + document + "` меньше нуля."s);
-    auto result = find(insert_doc_.begin(), insert_doc_.end(), document_id);
-    if (result != end(insert_doc_)) { // проверка на добавленные идентификаторы документов
+                "Идентификатор документа `"s + string(document)
+                        + "` меньше нуля."s);
+    if (documents_.Contains(document_id) || pending) { // проверка на добавленные идентификаторы документов
         throw invalid_argument(
                 "Идентификатор документа `"s + to_string(document_id)
                         + "` уже был добавлен."s);
@@ -201,32 +555,890 @@ void SearchServer::PossibleAddDocument(int document_id,
                         + "` пустой."s);  // Документ не может быть пустой
 }
 
-void SearchServer::ParseQuery(const string &text, Query &query) const {
-    if (!text.empty()) {
-        for (const string &word : SplitIntoWordsNoStop(text)) {
-            if (word[0] != '-')
-                query.plus_words.insert(word);
-            else {
-                query.minus_words.push_back(word.substr(1));
-            }
+SearchServer::WordCounts SearchServer::CountWords(string_view document) const {
+    // Один поиск в словаре на слово: он же проверяет стоп-слово
+    vector<uint32_t> term_ids;
+    vector<string_view> new_words;
+    for (string_view word : SplitIntoWords(document)) {
+        const uint32_t term_id = terms_.Find(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            new_words.push_back(word);
+        } else if (!terms_.IsStopWord(term_id)) {
+            term_ids.push_back(term_id);
+        }
+    }
+    WordCounts word_counts;
+    word_counts.length = static_cast<uint32_t>(term_ids.size()
+            + new_words.size());
+    sort(term_ids.begin(), term_ids.end());
+    for (uint32_t term_id : term_ids) {
+        if (word_counts.terms.empty()
+                || word_counts.terms.back().first != term_id) {
+            word_counts.terms.emplace_back(term_id, 0);
         }
+        ++word_counts.terms.back().second;
     }
+    sort(new_words.begin(), new_words.end());
+    for (string_view word : new_words) {
+        if (word_counts.new_words.empty()
+                || word_counts.new_words.back().first != word) {
+            word_counts.new_words.emplace_back(word, 0);
+        }
+        ++word_counts.new_words.back().second;
+    }
+    return word_counts;
+}
+
+void SearchServer::ParseQuery(string_view text, Query &query) const {
+    // Слова сразу раскладываются по спискам запроса, без промежуточного вектора
+    ForEachWord(text, [this, &query](string_view word) {
+        if (IsStopWord(word)) {
+            return;
+        }
+        if (word[0] != '-')
+            query.plus_words.push_back(word);
+        else {
+            query.minus_words.push_back(word.substr(1));
+        }
+    });
+    sort(query.plus_words.begin(), query.plus_words.end());
+    query.plus_words.erase(
+            unique(query.plus_words.begin(), query.plus_words.end()),
+            query.plus_words.end());
 }
 
 void SearchServer::CheckQurey(Query &query) const {
-    for (const string &word : query.minus_words) {
+    for (string_view word : query.minus_words) {
+        if (word.size() == 0l) {
+            throw invalid_argument("Запрос содержит пустые слова."s);
+        }
         if (word[0] == '-') {
             throw invalid_argument("Запрос содержит слово с двумя знаками -"s);
         }
-        if (word.size() == 0l) {
-            throw invalid_argument("Запрос содержит пустые слова."s);
+    }
+}
+
+pmr::vector<SearchServer::PostingsChunk> SearchServer::SplitPostings(
+        const Query &query, pmr::memory_resource *resource) const {
+    pmr::vector<PostingsChunk> chunks(resource);
+    for (size_t word = 0; word < query.plus_words.size(); ++word) {
+        const PostingsView postings = FindPostings(query.plus_words[word]);
+        const double idf = CalcIDF(query, word, postings);
+        for (size_t begin = 0; begin < postings.BlockCount();
+                begin += PARALLEL_POSTINGS_BLOCKS) {
+            chunks.push_back(
+                    { postings, idf, begin, min(postings.BlockCount(), begin
+                            + PARALLEL_POSTINGS_BLOCKS) });
         }
     }
+    return chunks;
 }
 
-double SearchServer::CalcIDF(const string &word) const {
-    return log(
-            static_cast<double>(document_count_)
-                    / static_cast<double>(word_to_document_freqs_.at(word).size()));
+SearchServer::ForwardTerms SearchServer::GetForwardTerms(int document_id) const {
+    ForwardTerms terms;
+    if (snapshot_) {
+        const SnapshotDocumentEntry *document = snapshot_->FindDocument(
+                document_id);
+        if (document != nullptr) {
+            terms.snapshot = snapshot_.get();
+            terms.word_indexes = snapshot_->ForwardWords()
+                    + document->forward_begin;
+            terms.size = document->forward_size;
+        }
+        return terms;
+    }
+    terms.dictionary = &terms_;
+    const DocumentTerms *document_terms = FindDocumentTerms(document_id);
+    if (document_terms != nullptr) {
+        terms.term_ids = document_terms->term_ids.data();
+        terms.size = document_terms->term_ids.size();
+    }
+    return terms;
+}
+
+SearchServer::PostingsView SearchServer::FindPostings(string_view word) const {
+    if (snapshot_) {
+        const size_t index = snapshot_->FindWord(word);
+        if (index == snapshot_->WordCount()) {
+            return {};
+        }
+        const SnapshotWordEntry &entry = snapshot_->WordEntry(index);
+        return { snapshot_->PostingBlocks() + entry.blocks_begin,
+                entry.block_count, snapshot_->PostingData() + entry.data_begin,
+                nullptr, 0, entry.postings_size, entry.log_document_freq,
+                entry.max_term_freq };
+    }
+    // У стоп-слов списков вхождений нет
+    const uint32_t term_id = terms_.Find(word);
+    if (term_id >= term_postings_.Size() || !term_postings_[term_id]) {
+        return {};
+    }
+    return term_postings_[term_id]->View();
 }
 
+uint32_t SearchServer::AddTerm(string_view word) {
+    const uint32_t term_id = terms_.Add(word);
+    if (term_id >= term_postings_.Size()) {
+        term_postings_.Resize(term_id + 1);
+    }
+    if (!term_postings_[term_id]) {
+        term_postings_.Mutable(term_id) = make_shared<PostingList>();
+    }
+    return term_id;
+}
+
+SearchServer::PostingList& SearchServer::MutablePostings(
+        shared_ptr<PostingList> &postings) {
+    if (postings.use_count() > 1) {
+        postings = make_shared<PostingList>(*postings);
+    }
+    return *postings;
+}
+
+double SearchServer::CalcIDF(const PostingsView &postings) const {
+    return log_document_count_ - postings.log_document_freq;
+}
+
+double SearchServer::CalcIDF(const Query &query, size_t index,
+        const PostingsView &postings) const {
+    if (!query.plus_idfs.empty()) {
+        return query.plus_idfs[index];
+    }
+    return CalcIDF(postings);
+}
+
+void SearchServer::UpdateDocumentCount(int delta) {
+    document_count_ += delta;
+    log_document_count_ =
+            document_count_ > 0 ? log(static_cast<double>(document_count_)) : 0.;
+}
+
+size_t SearchServer::PostingList::Size() const {
+    return size;
+}
+
+SearchServer::PostingsView SearchServer::PostingList::View() const {
+    return { blocks.data(), blocks.size(), data.data(), tail.data(), tail.size(),
+            size, log_document_freq, max_term_freq };
+}
+
+size_t SearchServer::PostingsView::Size() const {
+    return size;
+}
+
+size_t SearchServer::PostingsView::BlockCount() const {
+    return block_count + (tail_size > 0 ? 1 : 0);
+}
+
+int SearchServer::PostingsView::LastDocumentId(size_t block) const {
+    if (block == block_count) {
+        return tail[tail_size - 1].document_id;
+    }
+    return blocks[block].last_document_id;
+}
+
+size_t SearchServer::PostingsView::DecodeBlock(size_t block,
+        int *document_ids, double *term_freqs) const {
+    if (block == block_count) {
+        for (size_t i = 0; i < tail_size; ++i) {
+            document_ids[i] = tail[i].document_id;
+            if (term_freqs != nullptr) {
+                term_freqs[i] = static_cast<double>(tail[i].term_count)
+                        / tail[i].document_length;
+            }
+        }
+        return tail_size;
+    }
+    const int previous_id = block == 0 ? -1 : blocks[block - 1].last_document_id;
+    DecodePostingBlock(blocks[block], data, previous_id, document_ids,
+            term_freqs);
+    return blocks[block].size;
+}
+
+DocumentBitmap SearchServer::FindExcludedDocuments(const Query &query,
+        pmr::memory_resource *resource) const {
+    DocumentBitmap excluded(resource);
+    int document_ids[POSTING_BLOCK_SIZE];
+    for (string_view minus_word : query.minus_words) {
+        const PostingsView postings = FindPostings(minus_word);
+        for (size_t block = 0; block < postings.BlockCount(); ++block) {
+            const size_t size = postings.DecodeBlock(block, document_ids,
+                    nullptr);
+            for (size_t i = 0; i < size; ++i) {
+                excluded.Add(document_ids[i]);
+            }
+        }
+    }
+    return excluded;
+}
+
+string_view SearchServer::ForwardTerms::Find(string_view word) const {
+    if (dictionary != nullptr) {
+        const uint32_t term_id = dictionary->Find(word);
+        if (term_id != TermDictionary::NO_TERM
+                && binary_search(term_ids, term_ids + size, term_id)) {
+            return dictionary->Term(term_id);
+        }
+        return {};
+    }
+    if (snapshot != nullptr) {
+        const uint32_t *end = word_indexes + size;
+        const uint32_t *it = lower_bound(word_indexes, end, word,
+                [this](uint32_t index, string_view word) {
+                    return snapshot->Word(index) < word;
+                });
+        if (it != end && snapshot->Word(*it) == word) {
+            return snapshot->Word(*it);
+        }
+    }
+    return {};
+}
+
+void SearchServer::ForwardTerms::Match(const pmr::vector<string_view> &words,
+        vector<string_view> &matched) const {
+    // Слияние проходит все слова документа, поиск — log(size) на слово
+    // запроса. Термины в памяти упорядочены не по строкам, их только ищем.
+    size_t log_size = 1;
+    while ((size >> log_size) != 0) {
+        ++log_size;
+    }
+    if (snapshot == nullptr || words.size() * log_size < words.size() + size) {
+        for (string_view word : words) {
+            const string_view found = Find(word);
+            if (!found.empty()) {
+                matched.push_back(found);
+            }
+        }
+        return;
+    }
+
+    const uint32_t *index = word_indexes;
+    const uint32_t *end = word_indexes + size;
+    auto word = words.begin();
+    while (index != end && word != words.end()) {
+        const string_view document_word = snapshot->Word(*index);
+        if (document_word < *word) {
+            ++index;
+        } else {
+            if (document_word == *word) {
+                matched.push_back(document_word);
+                ++index;
+            }
+            ++word;
+        }
+    }
+}
+
+bool SearchServer::PostingsView::Contains(int document_id) const {
+    // Указатели пропуска: первый блок, последний документ которого не меньше искомого
+    const PostingBlock *blocks_end = blocks + block_count;
+    const PostingBlock *it = lower_bound(blocks, blocks_end, document_id,
+            [](const PostingBlock &block, int id) {
+                return block.last_document_id < id;
+            });
+    if (it == blocks_end) {
+        const PostingEntry *tail_end = tail + tail_size;
+        return binary_search(tail, tail_end, PostingEntry { document_id, 0, 0 },
+                [](const PostingEntry &lhs, const PostingEntry &rhs) {
+                    return lhs.document_id < rhs.document_id;
+                });
+    }
+    int document_ids[POSTING_BLOCK_SIZE];
+    const size_t count = DecodeBlock(it - blocks, document_ids, nullptr);
+    return binary_search(document_ids, document_ids + count, document_id);
+}
+
+vector<PostingEntry> SearchServer::PostingList::Decode() const {
+    vector<PostingEntry> entries(size);
+    size_t position = 0;
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        const int previous_id =
+                block == 0 ? -1 : blocks[block - 1].last_document_id;
+        DecodePostingBlock(blocks[block], data.data(), previous_id,
+                entries.data() + position);
+        position += blocks[block].size;
+    }
+    copy(tail.begin(), tail.end(), entries.begin() + position);
+    return entries;
+}
+
+int SearchServer::PostingList::LastDocumentId() const {
+    if (!tail.empty()) {
+        return tail.back().document_id;
+    }
+    return blocks.empty() ? -1 : blocks.back().last_document_id;
+}
+
+void SearchServer::PostingList::SealTail() {
+    data.resize(data.size() - min(data.size(), POSTING_DATA_PADDING));
+    const int previous_id = blocks.empty() ? -1 : blocks.back().last_document_id;
+    blocks.push_back(
+            EncodePostingBlock(tail.data(), tail.size(), previous_id, data));
+    data.resize(data.size() + POSTING_DATA_PADDING);
+    tail.clear();
+}
+
+void SearchServer::PostingList::UpdateDocumentFreq() {
+    log_document_freq = size == 0 ? 0. : log(static_cast<double>(size));
+}
+
+void SearchServer::PostingList::Remove(int document_id) {
+    if (blocks.empty() || document_id > blocks.back().last_document_id) {
+        const auto it = lower_bound(tail.begin(), tail.end(), document_id,
+                [](const PostingEntry &entry, int id) {
+                    return entry.document_id < id;
+                });
+        if (it == tail.end() || it->document_id != document_id) {
+            return;
+        }
+        tail.erase(it);
+    } else {
+        // Указатели пропуска: первый блок, последний документ которого не меньше искомого
+        const size_t block = lower_bound(blocks.begin(), blocks.end(),
+                document_id, [](const PostingBlock &candidate, int id) {
+                    return candidate.last_document_id < id;
+                }) - blocks.begin();
+        PostingEntry entries[POSTING_BLOCK_SIZE];
+        DecodePostingBlock(blocks[block], data.data(),
+                PreviousDocumentId(block), entries);
+        PostingEntry *entries_end = entries + blocks[block].size;
+        PostingEntry *it = lower_bound(entries, entries_end, document_id,
+                [](const PostingEntry &entry, int id) {
+                    return entry.document_id < id;
+                });
+        if (it == entries_end || it->document_id != document_id) {
+            return;
+        }
+        const bool last_in_block = it + 1 == entries_end;
+        entries_end = copy(it + 1, entries_end, it);
+        size_t next_block = block + 1;
+        if (entries_end == entries) {
+            unused_bytes += PostingBlockBytes(blocks[block]);
+            blocks.erase(blocks.begin() + block);
+            next_block = block;
+        } else {
+            ReplaceBlock(block, entries, entries_end - entries);
+        }
+        // Следующий блок был сжат от удалённого идентификатора
+        if (last_in_block && next_block < blocks.size()) {
+            DecodePostingBlock(blocks[next_block], data.data(), document_id,
+                    entries);
+            ReplaceBlock(next_block, entries, blocks[next_block].size);
+        }
+        if (unused_bytes * 2 > data.size()) {
+            CompactData();
+        }
+    }
+    --size;
+    UpdateDocumentFreq();
+}
+
+int SearchServer::PostingList::PreviousDocumentId(size_t block) const {
+    return block == 0 ? -1 : blocks[block - 1].last_document_id;
+}
+
+void SearchServer::PostingList::ReplaceBlock(size_t block,
+        const PostingEntry *entries, size_t count) {
+    const PostingBlock previous = blocks[block];
+    const size_t previous_bytes = PostingBlockBytes(previous);
+    // Блок сжимается в конец данных вместо отступа
+    data.resize(data.size() - POSTING_DATA_PADDING);
+    PostingBlock replaced = EncodePostingBlock(entries, count,
+            PreviousDocumentId(block), data);
+    const size_t replaced_bytes = PostingBlockBytes(replaced);
+    if (replaced_bytes <= previous_bytes) {
+        copy(data.begin() + replaced.offset, data.end(),
+                data.begin() + previous.offset);
+        data.resize(replaced.offset);
+        replaced.offset = previous.offset;
+        unused_bytes += previous_bytes - replaced_bytes;
+    } else {
+        unused_bytes += previous_bytes;
+    }
+    data.resize(data.size() + POSTING_DATA_PADDING);
+    blocks[block] = replaced;
+}
+
+void SearchServer::PostingList::CompactData() {
+    vector<uint8_t> compacted;
+    compacted.reserve(data.size() - unused_bytes);
+    for (PostingBlock &block : blocks) {
+        const auto block_begin = data.begin() + block.offset;
+        block.offset = static_cast<uint32_t>(compacted.size());
+        compacted.insert(compacted.end(), block_begin,
+                block_begin + PostingBlockBytes(block));
+    }
+    compacted.resize(compacted.size() + POSTING_DATA_PADDING);
+    data = move(compacted);
+    unused_bytes = 0;
+}
+
+void SearchServer::PostingList::Add(const PostingEntry &entry) {
+    max_term_freq = max(max_term_freq,
+            static_cast<double>(entry.term_count) / entry.document_length);
+    // Документы обычно добавляются с возрастающими идентификаторами,
+    // поэтому в большинстве случаев это просто добавление в хвост
+    if (entry.document_id > LastDocumentId()) {
+        tail.push_back(entry);
+        if (tail.size() == POSTING_BLOCK_SIZE) {
+            SealTail();
+        }
+    } else {
+        Insert(entry);
+    }
+    ++size;
+    UpdateDocumentFreq();
+}
+
+void SearchServer::PostingList::Insert(const PostingEntry &entry) {
+    const auto by_id = [](const PostingEntry &candidate, int id) {
+        return candidate.document_id < id;
+    };
+    if (blocks.empty() || entry.document_id > blocks.back().last_document_id) {
+        tail.insert(lower_bound(tail.begin(), tail.end(), entry.document_id,
+                by_id), entry);
+        if (tail.size() == POSTING_BLOCK_SIZE) {
+            SealTail();
+        }
+        return;
+    }
+    // Указатели пропуска: блок, в диапазон которого попадает документ. Его
+    // последний идентификатор не меняется, поэтому следующий блок остаётся
+    // сжатым от того же основания.
+    const size_t block = lower_bound(blocks.begin(), blocks.end(),
+            entry.document_id, [](const PostingBlock &candidate, int id) {
+                return candidate.last_document_id < id;
+            }) - blocks.begin();
+    PostingEntry entries[POSTING_BLOCK_SIZE + 1];
+    DecodePostingBlock(blocks[block], data.data(), PreviousDocumentId(block),
+            entries);
+    const size_t count = blocks[block].size + 1;
+    PostingEntry *position = lower_bound(entries, entries + count - 1,
+            entry.document_id, by_id);
+    copy_backward(position, entries + count - 1, entries + count);
+    *position = entry;
+    if (count <= POSTING_BLOCK_SIZE) {
+        ReplaceBlock(block, entries, count);
+    } else {
+        // Полный блок делится пополам; вторая половина сжимается
+        // в новый блок от последнего идентификатора первой
+        const size_t half = count / 2;
+        ReplaceBlock(block, entries, half);
+        blocks.insert(blocks.begin() + block + 1, PostingBlock { });
+        ReplaceBlock(block + 1, entries + half, count - half);
+    }
+    if (unused_bytes * 2 > data.size()) {
+        CompactData();
+    }
+}
+
+SearchServer::PostingsCursor::PostingsCursor(const PostingsView &postings) :
+        postings_(postings) {
+    if (postings_.BlockCount() > 0) {
+        LoadBlock(0);
+    }
+}
+
+bool SearchServer::PostingsCursor::AtEnd() const {
+    return position_ == count_;
+}
+
+int SearchServer::PostingsCursor::DocumentId() const {
+    return document_ids_[position_];
+}
+
+bool SearchServer::PostingsCursor::IsAt(int document_id) const {
+    return !AtEnd() && document_ids_[position_] == document_id;
+}
+
+double SearchServer::PostingsCursor::TermFreq() const {
+    return term_freqs_[position_];
+}
+
+void SearchServer::PostingsCursor::Next() {
+    ++position_;
+    if (position_ == count_ && block_ + 1 < postings_.BlockCount()) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void SearchServer::PostingsCursor::SkipTo(int target) {
+    if (AtEnd() || DocumentId() >= target) {
+        return;
+    }
+    if (postings_.LastDocumentId(block_) < target) {
+        // Двоичный поиск по последним идентификаторам сжатых блоков,
+        // хвост проверяется отдельно
+        const PostingBlock *blocks_end = postings_.blocks
+                + postings_.block_count;
+        const PostingBlock *it = lower_bound(
+                postings_.blocks + min(block_ + 1, postings_.block_count),
+                blocks_end, target, [](const PostingBlock &block, int id) {
+                    return block.last_document_id < id;
+                });
+        const size_t block = it - postings_.blocks;
+        if (block == postings_.BlockCount()
+                || postings_.LastDocumentId(block) < target) {
+            position_ = count_;
+            return;
+        }
+        LoadBlock(block);
+    }
+    position_ = lower_bound(document_ids_ + position_, document_ids_ + count_,
+            target) - document_ids_;
+}
+
+void SearchServer::PostingsCursor::LoadBlock(size_t block) {
+    block_ = block;
+    count_ = postings_.DecodeBlock(block, document_ids_, term_freqs_);
+    position_ = 0;
+}
+
+namespace {
+
+// Последовательная запись секций снимка с выравниванием на 8 байт.
+// Данные пишутся во временный файл рядом с path, который после записи
+// заменяет path: снимок по этому пути (в том числе отображённый в память)
+// остаётся целым, пока запись не закончена.
+class SnapshotWriter {
+public:
+    // Временный файл с уникальным именем создаётся рядом с path: одновременные
+    // сохранения не мешают друг другу, а rename остаётся в пределах одной ФС
+    explicit SnapshotWriter(const string &path) :
+            path_(path), temp_path_(path + ".XXXXXX"s) {
+        fd_ = mkstemp(temp_path_.data());
+        if (fd_ < 0) {
+            throw runtime_error("Не удалось создать файл снимка `"s + path + "`."s);
+        }
+        // mkstemp создаёт файл только для владельца, снимок же читают
+        // и другие процессы
+        fchmod(fd_, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        buffer_.reserve(BUFFER_SIZE);
+    }
+
+    // Недописанный временный файл удаляется
+    ~SnapshotWriter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        if (!committed_) {
+            unlink(temp_path_.c_str());
+        }
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Возвращает смещение начала записанных данных
+    template<typename T>
+    uint64_t Write(const T *data, size_t count) {
+        Align();
+        const uint64_t offset = offset_;
+        WriteBytes(reinterpret_cast<const char*>(data), count * sizeof(T));
+        return offset;
+    }
+
+    template<typename T>
+    uint64_t Write(const vector<T> &data) {
+        return Write(data.data(), data.size());
+    }
+
+    // Дописывает выравнивание, перезаписывает заголовок в начале файла
+    // и заменяет им файл path
+    void Finish(SnapshotHeader &header) {
+        Align();
+        header.file_size = offset_;
+        Flush();
+        WriteAt(reinterpret_cast<const char*>(&header), sizeof(header), 0);
+        Commit();
+    }
+
+    // Заменяет файл path записанными данными. Данные попадают на диск до
+    // rename, а запись каталога — после, так что после сбоя по пути
+    // лежит старый или новый снимок целиком.
+    void Commit() {
+        Flush();
+        if (fsync(fd_) != 0 || close(exchange(fd_, -1)) != 0) {
+            throw runtime_error("Ошибка записи файла снимка `"s + path_ + "`."s);
+        }
+        if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            throw runtime_error(
+                    "Не удалось заменить файл снимка `"s + path_ + "`."s);
+        }
+        committed_ = true;
+        SyncDirectory();
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = size_t(1) << 20;
+
+    string path_;
+    string temp_path_;
+    int fd_ = -1;
+    vector<char> buffer_;
+    uint64_t offset_ = 0;
+    bool committed_ = false;
+
+    void Align() {
+        static const char padding[8] = { };
+        const uint64_t tail = offset_ % 8;
+        if (tail != 0) {
+            WriteBytes(padding, 8 - tail);
+        }
+    }
+
+    // Мелкие записи копятся в буфере, крупные идут в файл напрямую
+    void WriteBytes(const char *data, size_t size) {
+        if (buffer_.size() + size > BUFFER_SIZE) {
+            Flush();
+        }
+        if (size >= BUFFER_SIZE) {
+            WriteAt(data, size, offset_);
+        } else {
+            buffer_.insert(buffer_.end(), data, data + size);
+        }
+        offset_ += size;
+    }
+
+    void Flush() {
+        WriteAt(buffer_.data(), buffer_.size(), offset_ - buffer_.size());
+        buffer_.clear();
+    }
+
+    void WriteAt(const char *data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            const ssize_t written = pwrite(fd_, data, size,
+                    static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                throw runtime_error(
+                        "Ошибка записи файла снимка `"s + path_ + "`."s);
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+    }
+
+    void SyncDirectory() const {
+        const size_t slash = path_.rfind('/');
+        const string directory = slash == string::npos ? "."s :
+                slash == 0 ? "/"s : path_.substr(0, slash);
+        const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        const bool synced = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!synced) {
+            throw runtime_error(
+                    "Не удалось сохранить каталог снимка `"s + path_ + "`."s);
+        }
+    }
+};
+
+}  // namespace
+
+void SearchServer::SaveSnapshot(const string &path) const {
+    if (snapshot_) {
+        // Индекс не менялся после открытия снимка — копируем файл как есть.
+        // Путь может совпадать с путём отображённого снимка.
+        const string_view bytes = snapshot_->Bytes();
+        SnapshotWriter writer(path);
+        writer.Write(bytes.data(), bytes.size());
+        writer.Commit();
+        return;
+    }
+
+    SnapshotHeader header = { };
+    copy(begin(SNAPSHOT_MAGIC), end(SNAPSHOT_MAGIC), header.magic);
+    header.version = SNAPSHOT_VERSION;
+    header.max_result_document_count = static_cast<uint32_t>(min<size_t>(
+            max_result_document_count_, numeric_limits<uint32_t>::max()));
+
+    SnapshotWriter writer(path);
+    writer.Write(&header, 1);
+
+    // Снимок хранит слова по возрастанию строк, а не в порядке идентификаторов
+    vector<string_view> stop_words;
+    vector<uint32_t> sorted_terms;
+    for (uint32_t term_id = 0; term_id < terms_.Size(); ++term_id) {
+        if (terms_.IsStopWord(term_id)) {
+            stop_words.push_back(terms_.Term(term_id));
+        } else if (term_postings_[term_id]->Size() != 0) {
+            // В снимок попадают только слова с непустыми списками вхождений
+            sorted_terms.push_back(term_id);
+        }
+    }
+    sort(stop_words.begin(), stop_words.end());
+    sort(sorted_terms.begin(), sorted_terms.end(),
+            [this](uint32_t lhs, uint32_t rhs) {
+                return terms_.Term(lhs) < terms_.Term(rhs);
+            });
+
+    vector<uint64_t> stop_word_offsets = { 0 };
+    string stop_word_chars;
+    for (string_view word : stop_words) {
+        stop_word_chars += word;
+        stop_word_offsets.push_back(stop_word_chars.size());
+    }
+    header.stop_word_count = stop_words.size();
+    header.stop_words_offset = writer.Write(stop_word_offsets);
+    header.stop_word_chars_offset = writer.Write(stop_word_chars.data(),
+            stop_word_chars.size());
+
+    vector<SnapshotWordEntry> words;
+    string word_chars;
+    vector<PostingBlock> posting_blocks;
+    vector<uint8_t> posting_data;
+    size_t posting_count = 0;
+    // Идентификатор термина -> индекс слова в снимке
+    vector<uint32_t> word_indexes(terms_.Size());
+    for (uint32_t term_id : sorted_terms) {
+        const string_view word = terms_.Term(term_id);
+        const shared_ptr<PostingList> &postings = term_postings_[term_id];
+        word_indexes[term_id] = static_cast<uint32_t>(words.size());
+        // Сжатые блоки копируются как есть, несжатый хвост сжимается
+        // в последний блок
+        vector<uint8_t> data(postings->data.begin(), postings->data.end()
+                - min(postings->data.size(), POSTING_DATA_PADDING));
+        vector<PostingBlock> blocks = postings->blocks;
+        if (!postings->tail.empty()) {
+            const int previous_id =
+                    blocks.empty() ? -1 : blocks.back().last_document_id;
+            blocks.push_back(EncodePostingBlock(postings->tail.data(),
+                    postings->tail.size(), previous_id, data));
+        }
+        words.push_back( { word_chars.size(), word.size(), posting_blocks.size(),
+                blocks.size(), posting_data.size(), postings->Size(),
+                postings->log_document_freq, postings->max_term_freq });
+        word_chars += word;
+        posting_blocks.insert(posting_blocks.end(), blocks.begin(),
+                blocks.end());
+        posting_data.insert(posting_data.end(), data.begin(), data.end());
+        posting_count += postings->Size();
+    }
+    posting_data.resize(posting_data.size() + POSTING_DATA_PADDING);
+    header.word_count = words.size();
+    header.posting_count = posting_count;
+    header.posting_block_count = posting_blocks.size();
+    header.posting_data_size = posting_data.size();
+    header.words_offset = writer.Write(words);
+    header.word_chars_offset = writer.Write(word_chars.data(), word_chars.size());
+    header.posting_blocks_offset = writer.Write(posting_blocks);
+    header.posting_data_offset = writer.Write(posting_data);
+
+    vector<SnapshotDocumentEntry> documents;
+    vector<uint32_t> forward_words;
+    vector<double> forward_freqs;
+    vector<pair<uint32_t, double>> document_words;
+    // Документы снимка упорядочены по идентификаторам
+    vector<uint32_t> ordinals;
+    ordinals.reserve(documents_.Size());
+    for (uint32_t ordinal = 0; ordinal < documents_.OrdinalCount(); ++ordinal) {
+        if (!documents_.IsRemoved(ordinal)) {
+            ordinals.push_back(ordinal);
+        }
+    }
+    sort(ordinals.begin(), ordinals.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return documents_.Id(lhs) < documents_.Id(rhs);
+    });
+    for (uint32_t ordinal : ordinals) {
+        const int document_id = documents_.Id(ordinal);
+        const DocumentTerms &document_terms = *documents_.Terms(ordinal);
+        document_words.clear();
+        for (size_t i = 0; i < document_terms.term_ids.size(); ++i) {
+            document_words.emplace_back(
+                    word_indexes[document_terms.term_ids[i]],
+                    document_terms.term_freqs[i]);
+        }
+        sort(document_words.begin(), document_words.end());
+        documents.push_back( { document_id, documents_.Rating(ordinal),
+                static_cast<int32_t>(documents_.Status(ordinal)), 0,
+                forward_words.size(), document_words.size() });
+        for (const auto& [word_index, freq] : document_words) {
+            forward_words.push_back(word_index);
+            forward_freqs.push_back(freq);
+        }
+    }
+    header.document_count = documents.size();
+    header.forward_count = forward_words.size();
+    header.documents_offset = writer.Write(documents);
+    header.forward_words_offset = writer.Write(forward_words);
+    header.forward_freqs_offset = writer.Write(forward_freqs);
+    header.insert_order_offset = writer.Write(documents_.Ids());
+
+    writer.Finish(header);
+}
+
+SearchServer SearchServer::OpenSnapshot(const string &path) {
+    SearchServer server;
+    server.snapshot_ = make_shared<const IndexSnapshot>(path);
+    for (size_t i = 0; i < server.snapshot_->StopWordCount(); ++i) {
+        server.terms_.MarkStopWord(
+                server.terms_.Add(server.snapshot_->StopWord(i)));
+    }
+    const SnapshotHeader &header = server.snapshot_->Header();
+    server.max_result_document_count_ = header.max_result_document_count;
+    server.UpdateDocumentCount(static_cast<int>(header.document_count));
+    return server;
+}
+
+void SearchServer::DetachSnapshot() {
+    if (!snapshot_) {
+        return;
+    }
+    detached_snapshot_ = move(snapshot_);
+    snapshot_.reset();
+    const shared_ptr<const IndexSnapshot> &snapshot = detached_snapshot_;
+
+    // Индекс слова в снимке -> идентификатор термина
+    vector<uint32_t> term_ids(snapshot->WordCount());
+    for (size_t i = 0; i < snapshot->WordCount(); ++i) {
+        const SnapshotWordEntry &entry = snapshot->WordEntry(i);
+        term_ids[i] = AddTerm(snapshot->Word(i));
+        PostingList &postings = MutablePostings(
+                term_postings_.Mutable(term_ids[i]));
+        // Блоки переносятся без распаковки
+        const PostingBlock *blocks = snapshot->PostingBlocks()
+                + entry.blocks_begin;
+        postings.blocks.assign(blocks, blocks + entry.block_count);
+        size_t data_size = 0;
+        for (const PostingBlock &block : postings.blocks) {
+            data_size = max<size_t>(data_size,
+                    block.offset + PostingBlockBytes(block));
+        }
+        const uint8_t *data = snapshot->PostingData() + entry.data_begin;
+        postings.data.assign(data, data + data_size);
+        postings.data.resize(data_size + POSTING_DATA_PADDING);
+        postings.size = entry.postings_size;
+        postings.log_document_freq = entry.log_document_freq;
+        postings.max_term_freq = entry.max_term_freq;
+    }
+
+    // Порядковые номера идут в порядке добавления документов
+    documents_.Reserve(snapshot->DocumentCount());
+    for (size_t i = 0; i < snapshot->DocumentCount(); ++i) {
+        const SnapshotDocumentEntry &entry = *snapshot->FindDocument(
+                snapshot->InsertOrder(i));
+        vector<pair<uint32_t, double>> document_words;
+        document_words.reserve(entry.forward_size);
+        for (uint64_t j = entry.forward_begin;
+                j < entry.forward_begin + entry.forward_size; ++j) {
+            document_words.emplace_back(term_ids[snapshot->ForwardWords()[j]],
+                    snapshot->ForwardFreqs()[j]);
+        }
+        sort(document_words.begin(), document_words.end());
+        auto document_terms = make_shared<DocumentTerms>();
+        document_terms->term_ids.reserve(document_words.size());
+        document_terms->term_freqs.reserve(document_words.size());
+        for (const auto& [term_id, freq] : document_words) {
+            document_terms->term_ids.push_back(term_id);
+            document_terms->term_freqs.push_back(freq);
+        }
+        documents_.Add(entry.id, entry.rating,
+                static_cast<DocumentStatus>(entry.status),
+                move(document_terms));
+    }
+}
@@ -8,163 +8,1154 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 #include <tuple>
 #include <algorithm>
 #include <set>
 #include <stdexcept>
+#include <execution>
+#include <mutex>
+#include <type_traits>
+#include <memory>
+#include <memory_resource>
+#include <limits>
+#include <optional>
+#include <chrono>
+#include <future>
+#include "chunked_vector.h"
+#include "compressed_postings.h"
+#include "concurrent_map.h"
+#include "document_bitmap.h"
 #include "document.h"
+#include "document_table.h"
+#include "query_arena.h"
+#include "query_cache.h"
+#include "query_executor.h"
+#include "query_stats.h"
+#include "score_accumulator.h"
+#include "snapshot.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-const double EPSILON = 1e-6;
+// Как последовательный FindTopDocuments отбирает документы. Выдача в обоих
+// режимах одинакова. EXHAUSTIVE считает релевантность всех вхождений слов
+// запроса. MAX_SCORE обходит документы по порядку и пропускает те, что по
+// верхней оценке релевантности уже не попадут в выдачу.
+enum class RetrievalMode {
+    EXHAUSTIVE, MAX_SCORE
+};
 
+// Копия сервера разделяет с оригиналом строки словаря, списки вхождений и
+// прямой индекс документов: копируются только словари верхнего уровня,
+// а список вхождений копируется при первом изменении (copy-on-write).
+// Копии можно менять независимо друг от друга.
 class SearchServer {
+    // Разбирает запрос один раз и передаёт серверам-шардам IDF по всему корпусу
+    friend class ShardedSearchServer;
+
 public:
 
     SearchServer();
     template<typename Container>
     explicit SearchServer(const Container &container);
     explicit SearchServer(const std::string &text_stop_words);
+    explicit SearchServer(std::string_view text_stop_words);
 
     int GetDocumentCount() const;
 
-    std::vector<std::string> SplitIntoWords(const std::string &text) const;
+    // Сколько документов возвращает FindTopDocuments, по умолчанию MAX_RESULT_DOCUMENT_COUNT
+    void SetMaxResultDocumentCount(size_t count);
+    size_t GetMaxResultDocumentCount() const;
+
+    // Режим отбора для последовательного поиска, по умолчанию EXHAUSTIVE.
+    // Параллельный поиск всегда считает все вхождения.
+    void SetRetrievalMode(RetrievalMode mode);
+    RetrievalMode GetRetrievalMode() const;
 
-    void AddDocument(int document_id, const std::string &document,
+    std::vector<std::string_view> SplitIntoWords(std::string_view text) const;
+
+    void AddDocument(int document_id, std::string_view document,
             DocumentStatus status, const std::vector<int> &rating);
 
+    struct DocumentToAdd {
+        int id = 0;
+        std::string_view text;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        std::vector<int> ratings;
+    };
+
+    // Добавляет пакет документов: разбор идёт параллельно по частям пакета,
+    // новые слова части попадают в словарь один раз, затем вхождения
+    // дописываются в списки по возрастанию id. Ошибки те же, что
+    // у AddDocument; при ошибке не добавляется ни один документ пакета.
+    void AddDocuments(const std::vector<DocumentToAdd> &documents);
+
     template<typename Filter>
-    std::vector<Document> FindTopDocuments(const std::string &raw_query,
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
             Filter filter_fun) const;
 
-    std::vector<Document> FindTopDocuments(const std::string &raw_query) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
-    std::vector<Document> FindTopDocuments(const std::string &raw_query,
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
             DocumentStatus find_status) const;
 
-    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(
-            const std::string &raw_query, int document_id) const;
+    // Перегрузки с политикой выполнения: std::execution::seq или std::execution::par
+    template<typename ExecutionPolicy, typename Filter>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+            std::string_view raw_query, Filter filter_fun) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+            std::string_view raw_query, DocumentStatus find_status) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+            std::string_view raw_query) const;
+
+    // Следующая страница выдачи: не больше max_result_document_count_
+    // документов, которые идут после курсора after. Отбираются только они,
+    // поэтому глубокая страница стоит столько же, сколько первая.
+    template<typename Filter>
+    std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query,
+            const SearchAfter &after, Filter filter_fun) const;
+
+    std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query,
+            const SearchAfter &after, DocumentStatus find_status =
+                    DocumentStatus::ACTUAL) const;
+
+    // Плюс-слова запроса, которые есть в документе, по возрастанию.
+    // Представления указывают в словарь сервера и действительны, пока жив
+    // сервер или его копия.
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::string_view raw_query, int document_id) const;
+
+    template<typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            ExecutionPolicy &&policy, std::string_view raw_query,
+            int document_id) const;
+
+    // Поиск по статусу через переданный кэш результатов
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            DocumentStatus find_status, QueryCache &cache) const;
+
+    // Последовательный поиск и сопоставление, которые заодно записывают
+    // в stats статистику выполнения запроса (query_stats.h)
+    template<typename Filter>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            Filter filter_fun, QueryStats &stats) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            DocumentStatus find_status, QueryStats &stats) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            DocumentStatus find_status, QueryCache &cache,
+            QueryStats &stats) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::string_view raw_query, int document_id,
+            QueryStats &stats) const;
+
+    // Встроенный кэш результатов поиска по статусу (FindTopDocuments без
+    // предиката). Записи сбрасываются при любом изменении индекса.
+    void EnableQueryCache(size_t max_bytes);
+    void DisableQueryCache();
+    QueryCache::Stats GetQueryCacheStats() const;
+
+    // Результат асинхронного поиска; partial — срок истёк и подсчёт
+    // релевантности остановлен, выдача составлена из уже посчитанного
+    struct SearchResult {
+        std::vector<Document> documents;
+        bool partial = false;
+    };
+
+    // Пул из thread_count потоков для FindTopDocumentsAsync, в очереди
+    // которого ждут не больше queue_limit запросов. Копии сервера делят пул.
+    void EnableAsyncQueries(size_t thread_count, size_t queue_limit);
+
+    // Последовательный поиск в пуле. Срок timeout отсчитывается от вызова,
+    // ожидание в очереди входит в него. Полная очередь — исключение
+    // QueryRejected; без EnableAsyncQueries — logic_error. Сервер должен
+    // пережить запросы.
+    template<typename Filter>
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query,
+            Filter filter_fun, std::chrono::steady_clock::duration timeout) const;
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query,
+            DocumentStatus find_status,
+            std::chrono::steady_clock::duration timeout) const;
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query,
+            std::chrono::steady_clock::duration timeout) const;
+
+    // Поколение индекса: меняется при каждом изменении сервера и
+    // не совпадает у серверов с разным содержимым
+    uint64_t GetGeneration() const;
 
     int GetDocumentId(int index) const;
 
+    // Частоты слов документа; для неизвестного документа — пустой словарь
+    const std::map<std::string_view, double>& GetWordFrequencies(
+            int document_id) const;
+
+    // Удаление затрагивает только списки вхождений слов самого документа
+    void RemoveDocument(int document_id);
+
+    template<typename ExecutionPolicy>
+    void RemoveDocument(ExecutionPolicy &&policy, int document_id);
+
+    // Сохраняет индекс в двоичный файл снимка (формат описан в snapshot.h)
+    void SaveSnapshot(const std::string &path) const;
+    // Отображает снимок в память; запросы обслуживаются прямо из отображения.
+    // Первое изменение сервера (AddDocument, RemoveDocument) переносит индекс
+    // в память, но отображение живёт, пока жив сервер или его копия: на него
+    // указывают выданные раньше представления слов.
+    static SearchServer OpenSnapshot(const std::string &path);
+
 private:
 
     struct DocumentProperties {
-        int rating;
-        DocumentStatus status;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
     };
 
+    // Память запроса берётся из арены (query_arena.h)
     struct Query {
-        std::set<std::string> plus_words;
-        std::vector<std::string> minus_words;
+        explicit Query(std::pmr::memory_resource *resource) :
+                plus_words(resource), minus_words(resource), plus_idfs(
+                        resource) {
+        }
+
+        // Слова запроса указывают в исходную строку запроса, плюс-слова
+        // отсортированы и не повторяются
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        // IDF плюс-слов по всему корпусу, когда документы разделены между
+        // серверами (ShardedSearchServer); если пусто, IDF считается по серверу
+        std::pmr::vector<double> plus_idfs;
+        // Курсор постраничного поиска
+        std::optional<SearchAfter> after;
+        // Срок запроса; когда он истекает, подсчёт релевантности прекращается
+        QueryDeadline *deadline = nullptr;
+    };
+
+    // Список вхождений слова только для чтения: сжатые блоки и несжатый
+    // хвост. Данные принадлежат PostingList или лежат в отображённом
+    // в память снимке (там хвоста нет).
+    struct PostingsView {
+        const PostingBlock *blocks = nullptr;
+        size_t block_count = 0;
+        const uint8_t *data = nullptr;
+        const PostingEntry *tail = nullptr;
+        size_t tail_size = 0;
+        size_t size = 0;
+        double log_document_freq = 0.;
+        double max_term_freq = 0.;
+
+        size_t Size() const;
+        // Число блоков вместе с хвостом, который считается последним блоком
+        size_t BlockCount() const;
+        int LastDocumentId(size_t block) const;
+        // Распаковывает блок (не больше POSTING_BLOCK_SIZE вхождений) и
+        // возвращает число вхождений в нём; term_freqs может быть nullptr
+        size_t DecodeBlock(size_t block, int *document_ids,
+                double *term_freqs) const;
+        bool Contains(int document_id) const;
+    };
+
+    // Слова документа из прямого индекса: идентификаторы терминов в памяти
+    // или индексы слов снимка, и те и другие по возрастанию
+    struct ForwardTerms {
+        const TermDictionary *dictionary = nullptr;
+        const uint32_t *term_ids = nullptr;
+        const IndexSnapshot *snapshot = nullptr;
+        const uint32_t *word_indexes = nullptr;
+        size_t size = 0;
+
+        // Слово из словаря сервера или пустое представление, если его нет в документе
+        std::string_view Find(std::string_view word) const;
+        // Дописывает в matched слова words (по возрастанию, без повторов),
+        // которые есть в документе. В памяти каждое слово ищется по хешу,
+        // в снимке — слиянием или двоичным поиском.
+        void Match(const std::pmr::vector<std::string_view> &words,
+                std::vector<std::string_view> &matched) const;
     };
 
-    std::vector<int> insert_doc_;
-    std::map<int, DocumentProperties> properties_documents_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
+    // Список вхождений слова по возрастанию идентификаторов документов.
+    // Полные блоки сжаты (compressed_postings.h), последние вхождения
+    // копятся несжатыми, пока не наберётся блок.
+    struct PostingList {
+        std::vector<PostingBlock> blocks;
+        // Данные блоков, за ними POSTING_DATA_PADDING нулевых байт. После
+        // удалений между данными блоков остаются неиспользуемые байты.
+        std::vector<uint8_t> data;
+        std::vector<PostingEntry> tail;
+        size_t size = 0;
+        // Неиспользуемые байты data; когда их больше половины, данные
+        // блоков переписываются подряд
+        size_t unused_bytes = 0;
+        // log(количества документов со словом), обновляется в Add и Remove.
+        // IDF = log_document_count_ - log_document_freq
+        double log_document_freq = 0.;
+        // Наибольшая частота слова в списке, для верхней оценки релевантности.
+        // Remove её не уменьшает, оценка остаётся верной.
+        double max_term_freq = 0.;
+
+        size_t Size() const;
+        PostingsView View() const;
+        // Вхождение с идентификатором меньше последнего пересжимает только
+        // свой блок
+        void Add(const PostingEntry &entry);
+        // Пересжимает только блок документа и, если сменился последний
+        // идентификатор блока, следующий блок, который распаковывается от него
+        void Remove(int document_id);
+        std::vector<PostingEntry> Decode() const;
+
+    private:
+        int LastDocumentId() const;
+        // Последний идентификатор перед блоком: от него распаковывается блок
+        int PreviousDocumentId(size_t block) const;
+        // Сжимает полный хвост в блок
+        void SealTail();
+        // Вставляет вхождение в хвост или в его блок; переполненный блок
+        // делится на два
+        void Insert(const PostingEntry &entry);
+        // Заменяет блок сжатыми entries: данные пишутся на место прежних,
+        // если помещаются, иначе в конец data
+        void ReplaceBlock(size_t block, const PostingEntry *entries,
+                size_t count);
+        // Переписывает данные блоков подряд, без неиспользуемых байт
+        void CompactData();
+        void UpdateDocumentFreq();
+    };
+
+    // Курсор для обхода списка вхождений по возрастанию идентификаторов
+    class PostingsCursor {
+    public:
+        explicit PostingsCursor(const PostingsView &postings);
+        // Список пройден. Отдельный признак, а не особый идентификатор:
+        // документом может быть любой неотрицательный int.
+        bool AtEnd() const;
+        // Текущий документ, если список не пройден
+        int DocumentId() const;
+        // Курсор стоит на документе document_id
+        bool IsAt(int document_id) const;
+        double TermFreq() const;
+        void Next();
+        // Переходит к первому документу не меньше target; блоки, где все
+        // документы меньше target, не распаковываются
+        void SkipTo(int target);
+
+    private:
+        PostingsView postings_;
+        size_t block_ = 0;
+        size_t count_ = 0;
+        size_t position_ = 0;
+        int document_ids_[POSTING_BLOCK_SIZE];
+        double term_freqs_[POSTING_BLOCK_SIZE];
+
+        void LoadBlock(size_t block);
+    };
+
+    // Запас для верхних оценок релевантности на ошибки округления сумм
+    static constexpr double SCORE_BOUND_SLACK = 1e-9;
+
+    // Плотный накопитель релевантности выбирается, если вхождений плюс-слов
+    // не меньше 1/DENSE_SCORES_RATIO числа документов
+    static constexpr size_t DENSE_SCORES_RATIO = 64;
+
+    // Раз во столько документов MAX_SCORE проверяет срок запроса
+    static constexpr size_t DEADLINE_CHECK_PERIOD = 128;
+
+    // Число бакетов параллельного накопителя релевантности
+    static constexpr size_t CONCURRENT_BUCKET_COUNT = 64;
+    // Размер части списка вхождений, обрабатываемой одной параллельной задачей
+    static constexpr size_t PARALLEL_POSTINGS_CHUNK = 4096;
+    // Число блоков списка вхождений, обрабатываемых одной параллельной задачей
+    static constexpr size_t PARALLEL_POSTINGS_BLOCKS = PARALLEL_POSTINGS_CHUNK
+            / POSTING_BLOCK_SIZE;
+    // Число документов пакета, разбираемых одной задачей в свой частичный индекс
+    static constexpr size_t BULK_DOCUMENTS_CHUNK = 1024;
+
+    // Рейтинги, статусы и прямой индекс (документ -> его термины
+    // с частотами) по порядковым номерам документов
+    DocumentTable documents_;
+    // Слова и стоп-слова. Термины не удаляются, даже если их список
+    // вхождений опустел
+    TermDictionary terms_;
+    // Списки вхождений по идентификатору термина; у стоп-слов пусто.
+    // Список, общий с копией сервера, перед изменением копируется
+    // (см. MutablePostings)
+    ChunkedVector<std::shared_ptr<PostingList>> term_postings_;
     int document_count_ = 0;
-    std::set<std::string> stop_words_;
+    // log(document_count_), пересчитывается при добавлении и удалении документов
+    double log_document_count_ = 0.;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    RetrievalMode retrieval_mode_ = RetrievalMode::EXHAUSTIVE;
+    // Пока задан, индекс читается из снимка, а контейнеры выше пусты
+    // (кроме стоп-слов и счётчиков документов)
+    std::shared_ptr<const IndexSnapshot> snapshot_;
+    // Снимок, из которого индекс перенесён в память. На него указывают
+    // результаты MatchDocument и GetWordFrequencies, полученные до переноса.
+    std::shared_ptr<const IndexSnapshot> detached_snapshot_;
+    uint64_t generation_ = NextGeneration();
+    std::shared_ptr<QueryCache> query_cache_;
+    std::shared_ptr<QueryExecutor> query_executor_;
+
+    static uint64_t NextGeneration();
+    // Ключ кэша: отсортированные плюс-слова, минус-слова и статус
+    static std::string MakeQueryCacheKey(const Query &query,
+            DocumentStatus status);
+    template<typename ExecutionPolicy, typename Stats>
+    std::vector<Document> FindTopDocumentsCached(ExecutionPolicy &&policy,
+            std::string_view raw_query, DocumentStatus find_status,
+            QueryCache &cache, Stats &stats) const;
+    // Поиск для FindTopDocumentsAsync в потоке пула
+    template<typename Filter>
+    SearchResult FindTopDocumentsUntil(std::string_view raw_query,
+            Filter filter_fun, QueryDeadline::Clock::time_point deadline) const;
+    // Stats — сборщик статистики: NoQueryStats или QueryStatsRecorder
+    template<typename Filter, typename Stats>
+    std::vector<Document> FindTopDocumentsWithStats(std::string_view raw_query,
+            Filter filter_fun, Stats &stats) const;
+    template<typename Stats>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocumentWithStats(
+            std::string_view raw_query, int document_id, Stats &stats) const;
 
     DocumentProperties GetPropertiesDocument(const int &id) const;
+    // Пустое представление, если слова нет в индексе
+    PostingsView FindPostings(std::string_view word) const;
+    ForwardTerms GetForwardTerms(int document_id) const;
+    // Переносит индекс из снимка в память перед изменением
+    void DetachSnapshot();
+    // Идентификатор термина, для которого уже есть список вхождений
+    uint32_t AddTerm(std::string_view word);
+    // Список вхождений, который можно менять, не затрагивая копии сервера
+    static PostingList& MutablePostings(std::shared_ptr<PostingList> &postings);
+
+    // nullptr, если документа нет
+    const DocumentTerms* FindDocumentTerms(int document_id) const;
+    // Списки вхождений слов документа и удаление его из служебных структур
+    std::vector<PostingList*> GetDocumentPostings(
+            const DocumentTerms &document_terms);
+    void EraseDocumentProperties(int document_id);
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
-    bool IsStopWord(const std::string &word) const;
-    std::vector<std::string> SplitIntoWordsNoStop(
-            const std::string &text) const;
-    static bool IsValidString(const std::string &str);
-    void PossibleAddDocument(int document_id,
-            const std::string &document) const;
-    void ParseQuery(const std::string &text, Query &query) const;
+    bool IsStopWord(std::string_view word) const;
+    // Вызывает func для каждого слова текста; слово с запрещёнными
+    // символами — исключение invalid_argument
+    template<typename Func>
+    static void ForEachWord(std::string_view text, Func func);
+    static bool IsValidString(std::string_view str);
+    // pending — идентификатор уже встречался раньше в добавляемом пакете
+    void PossibleAddDocument(int document_id, std::string_view document,
+            bool pending = false) const;
+    struct WordCounts {
+        // Слова из словаря: идентификатор термина и число вхождений,
+        // по возрастанию идентификаторов
+        std::vector<std::pair<uint32_t, uint32_t>> terms;
+        // Новые слова (указывают в текст документа) и число вхождений,
+        // по возрастанию
+        std::vector<std::pair<std::string_view, uint32_t>> new_words;
+        // Число слов документа без стоп-слов
+        uint32_t length = 0;
+    };
+    WordCounts CountWords(std::string_view document) const;
+    // Термин слова пакета (NO_TERM для стоп-слова) или, если слова нет
+    // в словаре, new_word_flag с номером слова в new_words: каждое новое
+    // слово попадает туда один раз
+    uint32_t FindBatchTerm(std::string_view word, uint32_t new_word_flag,
+            std::unordered_map<std::string_view, uint32_t> &new_word_indexes,
+            std::vector<std::string_view> &new_words) const;
+    void ParseQuery(std::string_view text, Query &query) const;
     void CheckQurey(Query &query) const;
-    double CalcIDF(const std::string &word) const;
+    double CalcIDF(const PostingsView &postings) const;
+    // IDF плюс-слова query.plus_words[index] с учётом query.plus_idfs
+    double CalcIDF(const Query &query, size_t index,
+            const PostingsView &postings) const;
+    // Документы с минус-словами запроса; строится до подсчёта релевантности
+    DocumentBitmap FindExcludedDocuments(const Query &query,
+            std::pmr::memory_resource *resource) const;
+    void UpdateDocumentCount(int delta);
+
+    // Возвращает не более max_result_document_count_ лучших документов в порядке выдачи
+    template<typename FilterFun, typename Stats>
+    std::vector<Document> FindAllDocuments(const Query &query,
+            FilterFun lambda_func, Stats &stats) const;
 
     template<typename FilterFun>
     std::vector<Document> FindAllDocuments(const Query &query,
+            FilterFun lambda_func) const {
+        NoQueryStats stats;
+        return FindAllDocuments(query, lambda_func, stats);
+    }
+
+    template<typename FilterFun>
+    std::vector<Document> FindAllDocuments(
+            const std::execution::parallel_policy&, const Query &query,
             FilterFun lambda_func) const;
+
+    // Статистика параллельного поиска не собирается
+    template<typename FilterFun>
+    std::vector<Document> FindAllDocuments(
+            const std::execution::parallel_policy &policy, const Query &query,
+            FilterFun lambda_func, NoQueryStats&) const {
+        return FindAllDocuments(policy, query, lambda_func);
+    }
+
+    template<typename FilterFun, typename Stats>
+    std::vector<Document> FindAllDocumentsMaxScore(const Query &query,
+            FilterFun lambda_func, Stats &stats) const;
+
+    template<typename FilterFun>
+    std::vector<Document> FindAllDocuments(
+            const std::execution::sequenced_policy&, const Query &query,
+            FilterFun lambda_func) const {
+        return FindAllDocuments(query, lambda_func);
+    }
+
+    template<typename FilterFun, typename Stats>
+    std::vector<Document> FindAllDocuments(
+            const std::execution::sequenced_policy&, const Query &query,
+            FilterFun lambda_func, Stats &stats) const {
+        return FindAllDocuments(query, lambda_func, stats);
+    }
+
+    // Часть списка вхождений слова: блоки [begin, end) внутри postings
+    struct PostingsChunk {
+        PostingsView postings;
+        double idf;
+        size_t begin;
+        size_t end;
+    };
+    // Части списков вхождений плюс-слов запроса
+    std::pmr::vector<PostingsChunk> SplitPostings(const Query &query,
+            std::pmr::memory_resource *resource) const;
 };
 
 template<typename Filter>
 std::vector<Document> SearchServer::FindTopDocuments(
-        const std::string &raw_query, Filter filter_fun) const {
-    std::vector<Document> result;
-    std::set<std::string> query_words;
-    Query query;
+        std::string_view raw_query, Filter filter_fun) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter_fun);
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+        std::string_view raw_query, DocumentStatus find_status) const {
+    if (query_cache_) {
+        NoQueryStats stats;
+        return FindTopDocumentsCached(policy, raw_query, find_status,
+                *query_cache_, stats);
+    }
+    return FindTopDocuments(policy, raw_query,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            });
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+        std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template<typename ExecutionPolicy, typename Filter>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+        std::string_view raw_query, Filter filter_fun) const {
+    const QueryArena arena;
+    Query query(arena.Resource());
+    ParseQuery(raw_query, query);
+    CheckQurey(query);
+    return FindAllDocuments(policy, query, filter_fun);
+}
+
+template<typename Filter>
+std::vector<Document> SearchServer::FindTopDocuments(
+        std::string_view raw_query, Filter filter_fun,
+        QueryStats &stats) const {
+    QueryStatsRecorder recorder(stats);
+    return FindTopDocumentsWithStats(raw_query, filter_fun, recorder);
+}
+
+template<typename Filter, typename Stats>
+std::vector<Document> SearchServer::FindTopDocumentsWithStats(
+        std::string_view raw_query, Filter filter_fun, Stats &stats) const {
+    const QueryArena arena;
+    Query query(arena.Resource());
+    {
+        const typename Stats::Phase phase(stats, QueryPhase::PARSE);
+        ParseQuery(raw_query, query);
+        CheckQurey(query);
+    }
+    return FindAllDocuments(query, filter_fun, stats);
+}
+
+template<typename Filter>
+std::future<SearchServer::SearchResult> SearchServer::FindTopDocumentsAsync(
+        std::string_view raw_query, Filter filter_fun,
+        std::chrono::steady_clock::duration timeout) const {
+    if (!query_executor_) {
+        throw std::logic_error(
+                "Асинхронные запросы не включены (EnableAsyncQueries).");
+    }
+    const QueryDeadline::Clock::time_point deadline =
+            QueryDeadline::Clock::now() + timeout;
+    auto promise = std::make_shared<std::promise<SearchResult>>();
+    std::future<SearchResult> result = promise->get_future();
+    // Строка запроса копируется: задача переживает вызов
+    const bool accepted = query_executor_->TrySubmit(
+            [this, text = std::string(raw_query), filter_fun, deadline,
+                    promise] {
+                try {
+                    promise->set_value(
+                            FindTopDocumentsUntil(text, filter_fun, deadline));
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            });
+    if (!accepted) {
+        throw QueryRejected("Очередь асинхронных запросов заполнена.");
+    }
+    return result;
+}
+
+template<typename Filter>
+SearchServer::SearchResult SearchServer::FindTopDocumentsUntil(
+        std::string_view raw_query, Filter filter_fun,
+        QueryDeadline::Clock::time_point deadline) const {
+    QueryDeadline query_deadline(deadline);
+    SearchResult result;
+    if (query_deadline.Passed()) {
+        // Срок истёк в очереди
+        result.partial = true;
+        return result;
+    }
+    const QueryArena arena;
+    Query query(arena.Resource());
+    ParseQuery(raw_query, query);
+    CheckQurey(query);
+    query.deadline = &query_deadline;
+    result.documents = FindAllDocuments(query, filter_fun);
+    result.partial = query_deadline.WasPassed();
+    return result;
+}
+
+template<typename Filter>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(
+        std::string_view raw_query, const SearchAfter &after,
+        Filter filter_fun) const {
+    const QueryArena arena;
+    Query query(arena.Resource());
     ParseQuery(raw_query, query);
     CheckQurey(query);
-    result = FindAllDocuments(query, filter_fun);
+    query.after = after;
+    return FindAllDocuments(query, filter_fun);
+}
+
+template<typename ExecutionPolicy, typename Stats>
+std::vector<Document> SearchServer::FindTopDocumentsCached(
+        ExecutionPolicy &&policy, std::string_view raw_query,
+        DocumentStatus find_status, QueryCache &cache, Stats &stats) const {
+    const QueryArena arena;
+    Query query(arena.Resource());
+    std::string key;
+    {
+        const typename Stats::Phase phase(stats, QueryPhase::PARSE);
+        ParseQuery(raw_query, query);
+        CheckQurey(query);
+        key = MakeQueryCacheKey(query, find_status);
+    }
+    const uint64_t generation = generation_;
+    if (auto cached = cache.Find(key, generation)) {
+        stats.SetResults(cached->size());
+        return std::move(*cached);
+    }
+    std::vector<Document> result = FindAllDocuments(policy, query,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            }, stats);
+    cache.Insert(key, generation, result);
+    return result;
+}
+
+template<typename FilterFun>
+std::vector<Document> SearchServer::FindAllDocuments(
+        const std::execution::parallel_policy&, const Query &query,
+        FilterFun lambda_func) const {
+    TopDocuments top_documents(max_result_document_count_, query.after);
+    if (query.plus_words.empty()) {
+        return top_documents.Extract();
+    }
 
-    auto by_relevance = [](const Document &lhs, const Document &rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
+    // Накопитель заполняют потоки пула, поэтому он в общей куче,
+    // а не в арене вызывающего потока
+    ConcurrentMap<int, double> query_result(CONCURRENT_BUCKET_COUNT);
+    const QueryArena arena;
+    const DocumentBitmap excluded = FindExcludedDocuments(query,
+            arena.Resource());
+
+    const std::pmr::vector<PostingsChunk> plus_chunks = SplitPostings(query,
+            arena.Resource());
+    std::for_each(std::execution::par, plus_chunks.begin(), plus_chunks.end(),
+            [&query_result, &excluded](const PostingsChunk &chunk) {
+                int document_ids[POSTING_BLOCK_SIZE];
+                double term_freqs[POSTING_BLOCK_SIZE];
+                for (size_t block = chunk.begin; block < chunk.end; ++block) {
+                    const size_t count = chunk.postings.DecodeBlock(block,
+                            document_ids, term_freqs);
+                    for (size_t i = 0; i < count; ++i) {
+                        if (!excluded.Contains(document_ids[i])) {
+                            query_result[document_ids[i]].ref_to_value +=
+                                    chunk.idf * term_freqs[i];
+                        }
+                    }
+                }
+            });
+
+    std::mutex result_mutex;
+    query_result.ForEachBucket(std::execution::par,
+            [&](const std::map<int, double> &bucket) {
+                TopDocuments bucket_documents(max_result_document_count_,
+                        query.after);
+                for (const auto& [document_id, relevance] : bucket) {
+                    const DocumentProperties doc_prop = GetPropertiesDocument(
+                            document_id);
+                    if (lambda_func(document_id, doc_prop.status,
+                            doc_prop.rating)) {
+                        bucket_documents.Push( // @suppress("Invalid arguments")
+                                { document_id, relevance, doc_prop.rating });
+                    }
+                }
+                std::lock_guard guard(result_mutex);
+                top_documents.Merge(bucket_documents);
+            });
+    return top_documents.Extract();
+}
+
+template<typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+        ExecutionPolicy &&policy, std::string_view raw_query,
+        int document_id) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>,
+            std::execution::sequenced_policy>) {
+        return MatchDocument(raw_query, document_id);
+    } else {
+        const QueryArena arena;
+        Query query(arena.Resource());
+        ParseQuery(raw_query, query);
+        CheckQurey(query);
+
+        const DocumentStatus doc_stat =
+                GetPropertiesDocument(document_id).status;
+        const ForwardTerms terms = GetForwardTerms(document_id);
+        auto find_word = [&terms](std::string_view word) {
+            return terms.Find(word);
+        };
+
+        std::vector<std::string_view> v_result;
+        if (std::any_of(policy, query.minus_words.begin(),
+                query.minus_words.end(), [&find_word](std::string_view word) {
+                    return !find_word(word).empty();
+                })) {
+            return std::tuple(v_result, doc_stat);
+        }
+
+        // plus_words уже отсортированы и не содержат повторов
+        const std::pmr::vector<std::string_view> &plus_words =
+                query.plus_words;
+        std::pmr::vector<std::string_view> matched(plus_words.size(),
+                arena.Resource());
+        std::transform(policy, plus_words.begin(), plus_words.end(),
+                matched.begin(), find_word);
+        for (std::string_view word : matched) {
+            if (!word.empty()) {
+                v_result.push_back(word);
+            }
+        }
+        return std::tuple(v_result, doc_stat);
+    }
+}
+
+template<typename Func>
+void SearchServer::ForEachWord(std::string_view text, Func func) {
+    while (true) {
+        const size_t begin = text.find_first_not_of(' ');
+        if (begin == std::string_view::npos) {
+            break;
         }
-        return lhs.relevance > rhs.relevance;
+        text.remove_prefix(begin);
+        const size_t end = std::min(text.find(' '), text.size());
+        const std::string_view word = text.substr(0, end);
+        if (!IsValidString(word)) {
+            throw std::invalid_argument(
+                    "Слово `" + std::string(word)
+                            + "` имеет запрещенные символы.");
+        }
+        func(word);
+        text.remove_prefix(end);
+    }
+}
+
+template<typename FilterFun, typename Stats>
+std::vector<Document> SearchServer::FindAllDocumentsMaxScore(const Query &query,
+        FilterFun lambda_func, Stats &stats) const {
+    TopDocuments top_documents(max_result_document_count_, query.after);
+    if (max_result_document_count_ == 0) {
+        return top_documents.Extract();
+    }
+    typename Stats::Phase scoring(stats, QueryPhase::SCORING);
+
+    // Слова запроса по возрастанию верхней оценки вклада idf * max tf.
+    // Вклады документа складываются в порядке plus_words, как при полном
+    // подсчёте, поэтому релевантность совпадает до бита.
+    struct Term {
+        size_t index;
+        double idf;
+        double upper_bound;
+        PostingsCursor cursor;
     };
+    const QueryArena arena;
+    std::pmr::vector<Term> terms(arena.Resource());
+    terms.reserve(query.plus_words.size());
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const PostingsView postings = FindPostings(query.plus_words[i]);
+        if (postings.Size() != 0) {
+            const double idf = CalcIDF(query, i, postings);
+            terms.push_back( { i, idf, idf * postings.max_term_freq
+                    + SCORE_BOUND_SLACK, PostingsCursor(postings) });
+        }
+    }
+    std::sort(terms.begin(), terms.end(), [](const Term &lhs, const Term &rhs) {
+        return lhs.upper_bound < rhs.upper_bound;
+    });
+    // bounds[i] — сумма верхних оценок слов [0, i]
+    std::pmr::vector<double> bounds(terms.size(), arena.Resource());
+    double bounds_sum = 0.;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        bounds_sum += terms[i].upper_bound;
+        bounds[i] = bounds_sum;
+    }
+    const DocumentBitmap excluded = MeasurePhase(stats,
+            QueryPhase::MINUS_WORDS, [&] {
+                return FindExcludedDocuments(query, arena.Resource());
+            });
 
-    std::sort(result.begin(), result.end(), by_relevance);
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+    // Документ попадает в заполненную кучу, только если его релевантность
+    // не меньше relevance худшего - EPSILON (см. IsMoreRelevant). Слова
+    // [0, first_essential) вместе не дают такой релевантности, поэтому
+    // кандидаты берутся только из списков остальных слов.
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t first_essential = 0;
+    std::pmr::vector<double> contributions(query.plus_words.size(),
+            arena.Resource());
+    size_t iteration = 0;
+    while (first_essential < terms.size()) {
+        if (query.deadline != nullptr
+                && ++iteration % DEADLINE_CHECK_PERIOD == 0
+                && query.deadline->Passed()) {
+            break;
+        }
+        bool found = false;
+        int document_id = 0;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            const PostingsCursor &cursor = terms[i].cursor;
+            if (!cursor.AtEnd()
+                    && (!found || cursor.DocumentId() < document_id)) {
+                document_id = cursor.DocumentId();
+                found = true;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        if (excluded.Contains(document_id)) {
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                if (terms[i].cursor.IsAt(document_id)) {
+                    terms[i].cursor.Next();
+                }
+            }
+            continue;
+        }
+
+        std::fill(contributions.begin(), contributions.end(), 0.);
+        double bound = 0.;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            PostingsCursor &cursor = terms[i].cursor;
+            if (cursor.IsAt(document_id)) {
+                const double contribution = terms[i].idf * cursor.TermFreq();
+                contributions[terms[i].index] = contribution;
+                bound += contribution + SCORE_BOUND_SLACK;
+                cursor.Next();
+                stats.AddPostings(1);
+            }
+        }
+        bool pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (bound + bounds[i] < threshold) {
+                pruned = true;
+                break;
+            }
+            PostingsCursor &cursor = terms[i].cursor;
+            cursor.SkipTo(document_id);
+            if (cursor.IsAt(document_id)) {
+                const double contribution = terms[i].idf * cursor.TermFreq();
+                contributions[terms[i].index] = contribution;
+                bound += contribution + SCORE_BOUND_SLACK;
+                stats.AddPostings(1);
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+        stats.AddCandidates(1);
+        const DocumentProperties doc_prop = GetPropertiesDocument(document_id);
+        if (!MeasureSampledPhase(stats, QueryPhase::PREDICATE, [&] {
+            return lambda_func(document_id, doc_prop.status, doc_prop.rating);
+        })) {
+            continue;
+        }
+        double relevance = 0.;
+        for (double contribution : contributions) {
+            relevance += contribution;
+        }
+        top_documents.Push( // @suppress("Invalid arguments")
+                { document_id, relevance, doc_prop.rating });
+        if (top_documents.IsFull()) {
+            threshold = top_documents.Worst().relevance - EPSILON;
+            while (first_essential < terms.size()
+                    && bounds[first_essential] < threshold) {
+                ++first_essential;
+            }
+        }
     }
+    const typename Stats::Phase sorting(stats, QueryPhase::SORTING);
+    std::vector<Document> result = top_documents.Extract();
+    stats.SetResults(result.size());
     return result;
 }
 
-template<typename FilterFun>
+template<typename FilterFun, typename Stats>
 std::vector<Document> SearchServer::FindAllDocuments(const Query &query,
-        FilterFun lambda_func) const {
-    std::vector<Document> matched_documents;
-    std::map<int, double> query_result;
-
-    if (query.plus_words.size() != 0) {
-        for (const std::string &plus_word : query.plus_words) {
-            const auto &temp_map = word_to_document_freqs_.find(plus_word);
-            if (temp_map != word_to_document_freqs_.end()) {
-                const std::map<int, double> &temp_set = temp_map->second;
-                double idf = CalcIDF(plus_word);
-                for (auto &element : temp_set) {
-                    double &rel = query_result[element.first];
-                    rel = rel + idf * element.second;
+        FilterFun lambda_func, Stats &stats) const {
+    if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+        return FindAllDocumentsMaxScore(query, lambda_func, stats);
+    }
+    TopDocuments top_documents(max_result_document_count_, query.after);
+    if (query.plus_words.empty()) {
+        return top_documents.Extract();
+    }
+    // Арена своя: у ShardedSearchServer шарды ищут в потоках пула
+    const QueryArena arena;
+    const DocumentBitmap excluded = MeasurePhase(stats,
+            QueryPhase::MINUS_WORDS, [&] {
+                return FindExcludedDocuments(query, arena.Resource());
+            });
+    std::pmr::vector<PostingsView> plus_postings(arena.Resource());
+    plus_postings.reserve(query.plus_words.size());
+    size_t posting_count = 0;
+    for (std::string_view word : query.plus_words) {
+        plus_postings.push_back(FindPostings(word));
+        posting_count += plus_postings.back().Size();
+    }
+    stats.AddPostings(posting_count);
+
+    // Вклады слов по порядку plus_words, как в остальных способах отбора
+    const auto for_each_posting = [&](auto add) {
+        const typename Stats::Phase phase(stats, QueryPhase::SCORING);
+        int document_ids[POSTING_BLOCK_SIZE];
+        double term_freqs[POSTING_BLOCK_SIZE];
+        for (size_t word = 0; word < plus_postings.size(); ++word) {
+            const PostingsView &postings = plus_postings[word];
+            if (postings.Size() == 0) {
+                continue;
+            }
+            const double idf = CalcIDF(query, word, postings);
+            for (size_t block = 0; block < postings.BlockCount(); ++block) {
+                if (query.deadline != nullptr && query.deadline->Passed()) {
+                    return;
+                }
+                const size_t count = postings.DecodeBlock(block, document_ids,
+                        term_freqs);
+                for (size_t i = 0; i < count; ++i) {
+                    if (!excluded.Contains(document_ids[i])) {
+                        add(document_ids[i], idf * term_freqs[i]);
+                    }
+                }
+            }
+        }
+    };
+
+    // Плотный массив окупается, когда вхождений запроса много относительно
+    // числа документов: вклад пишется по смещению идентификатора, без
+    // хеширования на каждое вхождение. Массив не длиннее MAX_DOCUMENTS,
+    // поэтому идентификаторы обходятся окнами; списки упорядочены по
+    // идентификаторам, так что каждый блок распаковывается один раз.
+    if (DenseScores::IsAvailable() && posting_count * DENSE_SCORES_RATIO
+            >= static_cast<size_t>(document_count_)) {
+        // Распакованный блок слова и позиция в нём; count == 0 — список кончился
+        struct WindowCursor {
+            const PostingsView *postings = nullptr;
+            double idf = 0.;
+            size_t block = 0;
+            size_t count = 0;
+            size_t position = 0;
+            int document_ids[POSTING_BLOCK_SIZE];
+            double term_freqs[POSTING_BLOCK_SIZE];
+        };
+        std::pmr::vector<WindowCursor> cursors(arena.Resource());
+        cursors.reserve(plus_postings.size());
+        int last_document_id = 0;
+        bool deadline_passed = false;
+        const auto decode_block = [&](WindowCursor &cursor) {
+            cursor.position = 0;
+            cursor.count = 0;
+            if (cursor.block == cursor.postings->BlockCount()) {
+                return;
+            }
+            if (query.deadline != nullptr && query.deadline->Passed()) {
+                deadline_passed = true;
+                return;
+            }
+            cursor.count = cursor.postings->DecodeBlock(cursor.block,
+                    cursor.document_ids, cursor.term_freqs);
+        };
+        {
+            const typename Stats::Phase phase(stats, QueryPhase::SCORING);
+            for (size_t word = 0; word < plus_postings.size(); ++word) {
+                const PostingsView &postings = plus_postings[word];
+                if (postings.Size() == 0) {
+                    continue;
                 }
+                WindowCursor &cursor = cursors.emplace_back();
+                cursor.postings = &postings;
+                cursor.idf = CalcIDF(query, word, postings);
+                decode_block(cursor);
+                last_document_id = std::max(last_document_id,
+                        postings.LastDocumentId(postings.BlockCount() - 1));
             }
         }
-        if (query.minus_words.size() != 0) {
-            for (const std::string &minus_word : query.minus_words) {
-                const auto &temp_map = word_to_document_freqs_.find(minus_word);
-                if (temp_map != word_to_document_freqs_.end()) {
-                    const std::map<int, double> &temp_set = temp_map->second;
-                    for (auto &element : temp_set) {
-                        query_result.erase(element.first);
+        while (!deadline_passed) {
+            int window_begin = last_document_id;
+            bool exhausted = true;
+            for (const WindowCursor &cursor : cursors) {
+                if (cursor.position < cursor.count) {
+                    window_begin = std::min(window_begin,
+                            cursor.document_ids[cursor.position]);
+                    exhausted = false;
+                }
+            }
+            if (exhausted) {
+                break;
+            }
+            const size_t window_size = std::min(DenseScores::MAX_DOCUMENTS,
+                    static_cast<size_t>(last_document_id - window_begin) + 1);
+            const int64_t window_end = window_begin
+                    + static_cast<int64_t>(window_size);
+            DenseScores scores(window_size);
+            {
+                // Вклады слов по порядку plus_words, как в остальных
+                // способах отбора
+                const typename Stats::Phase phase(stats, QueryPhase::SCORING);
+                for (WindowCursor &cursor : cursors) {
+                    while (cursor.position < cursor.count
+                            && cursor.document_ids[cursor.position]
+                                    < window_end) {
+                        const int document_id =
+                                cursor.document_ids[cursor.position];
+                        if (!excluded.Contains(document_id)) {
+                            scores.Add(
+                                    static_cast<uint32_t>(document_id
+                                            - window_begin),
+                                    cursor.idf
+                                            * cursor.term_freqs[cursor.position]);
+                        }
+                        if (++cursor.position == cursor.count) {
+                            ++cursor.block;
+                            decode_block(cursor);
+                        }
                     }
                 }
             }
+            const typename Stats::Phase phase(stats, QueryPhase::SORTING);
+            scores.ForEach([&](uint32_t index, double relevance) {
+                stats.AddCandidates(1);
+                const int document_id = window_begin + static_cast<int>(index);
+                const DocumentProperties doc_prop = GetPropertiesDocument(
+                        document_id);
+                if (MeasureSampledPhase(stats, QueryPhase::PREDICATE, [&] {
+                    return lambda_func(document_id, doc_prop.status,
+                            doc_prop.rating);
+                })) {
+                    top_documents.Push( // @suppress("Invalid arguments")
+                            { document_id, relevance, doc_prop.rating });
+                }
+            });
         }
-        for (auto &res : query_result) {
-            SearchServer::DocumentProperties doc_prop = GetPropertiesDocument(
-                    res.first);
-            if (lambda_func(res.first, doc_prop.status, doc_prop.rating)) {
-                matched_documents.push_back( // @suppress("Invalid arguments")
-                        { res.first, res.second, doc_prop.rating });
+    } else {
+        SparseScores scores(
+                std::min(posting_count,
+                        static_cast<size_t>(document_count_)),
+                arena.Resource());
+        for_each_posting([&scores](int document_id, double score) {
+            scores.Add(document_id, score);
+        });
+        const typename Stats::Phase phase(stats, QueryPhase::SORTING);
+        scores.ForEach([&](int document_id, double relevance) {
+            stats.AddCandidates(1);
+            const DocumentProperties doc_prop = GetPropertiesDocument(
+                    document_id);
+            if (MeasureSampledPhase(stats, QueryPhase::PREDICATE, [&] {
+                return lambda_func(document_id, doc_prop.status,
+                        doc_prop.rating);
+            })) {
+                top_documents.Push( // @suppress("Invalid arguments")
+                        { document_id, relevance, doc_prop.rating });
             }
+        });
+    }
+    const typename Stats::Phase sorting(stats, QueryPhase::SORTING);
+    std::vector<Document> result = top_documents.Extract();
+    stats.SetResults(result.size());
+    return result;
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::RemoveDocument(ExecutionPolicy &&policy, int document_id) {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>,
+            std::execution::sequenced_policy>) {
+        RemoveDocument(document_id);
+    } else {
+        DetachSnapshot();
+        generation_ = NextGeneration();
+        const DocumentTerms *document_terms = FindDocumentTerms(document_id);
+        if (document_terms == nullptr) {
+            return;
         }
+        // Каждое слово документа встречается один раз, поэтому потоки
+        // меняют разные списки вхождений
+        std::vector<PostingList*> postings = GetDocumentPostings(
+                *document_terms);
+        std::for_each(policy, postings.begin(), postings.end(),
+                [document_id](PostingList *word_postings) {
+                    word_postings->Remove(document_id);
+                });
+        EraseDocumentProperties(document_id);
     }
-    return matched_documents;
 }
 
 template<typename Container>
 SearchServer::SearchServer(const Container &container) {
 
-    for (const std::string &word : container) {
+    for (const auto &word : container) {
+        const std::string_view word_view = word;
 
-        if (!IsValidString(word)) {
+        if (!IsValidString(word_view)) {
             throw std::invalid_argument(
-                    "Слово `" + word + "` имеет запрещенные символы.");
-            std::vector<std::string> words;
+                    "Слово `" + std::string(word_view)
+                            + "` имеет запрещенные символы.");
         }
 
-        const auto &result = find(begin(stop_words_), end(stop_words_), word);
-        if (result == stop_words_.end())
-            if (!word.empty()) {
-                stop_words_.insert(word);
-            }
+        if (!word_view.empty()) {
+            terms_.MarkStopWord(terms_.Add(word_view));
+        }
     }
 }
 
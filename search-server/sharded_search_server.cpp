@@ -0,0 +1,94 @@
+/*
+ * sharded_search_server.cpp
+ */
+#include "sharded_search_server.h"
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document,
+        DocumentStatus status, const vector<int> &ratings) {
+    // Повторный идентификатор попадает в тот же шард, и шард его отклоняет
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document,
+            status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+    for (SearchServer &shard : shards_) {
+        shard.SetMaxResultDocumentCount(count);
+    }
+}
+
+size_t ShardedSearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer &shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return hash<int>()(document_id) % shards_.size();
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(
+        string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query,
+        DocumentStatus find_status) const {
+    return FindTopDocuments(raw_query,
+            [find_status](int document_id, DocumentStatus status, int rating) {
+                return status == find_status;
+            });
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+        string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query,
+            document_id);
+}
+
+SearchServer::Query ShardedSearchServer::ParseQuery(string_view raw_query,
+        pmr::memory_resource *resource) const {
+    // Стоп-слова у шардов общие, поэтому разбор по первому шарду подходит всем
+    const SearchServer &first_shard = shards_.front();
+    SearchServer::Query query(resource);
+    first_shard.ParseQuery(raw_query, query);
+    first_shard.CheckQurey(query);
+
+    // Те же выражения, что у SearchServer, чтобы IDF совпадал до бита
+    const int document_count = GetDocumentCount();
+    const double log_document_count =
+            document_count > 0 ? log(static_cast<double>(document_count)) : 0.;
+    query.plus_idfs.reserve(query.plus_words.size());
+    for (string_view word : query.plus_words) {
+        size_t document_freq = 0;
+        for (const SearchServer &shard : shards_) {
+            document_freq += shard.FindPostings(word).Size();
+        }
+        const double log_document_freq =
+                document_freq == 0 ? 0. : log(static_cast<double>(document_freq));
+        query.plus_idfs.push_back(log_document_count - log_document_freq);
+    }
+    return query;
+}
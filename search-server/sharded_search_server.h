@@ -0,0 +1,99 @@
+#pragma once
+/*
+ * sharded_search_server.h
+ *
+ *  Поисковый сервер, документы которого разделены между несколькими
+ *  SearchServer по хешу идентификатора. Запрос разбирается один раз,
+ *  шарды ищут параллельно, их лучшие документы сливаются в общую выдачу.
+ *
+ *  IDF плюс-слов считается по всем шардам, поэтому релевантность совпадает
+ *  с поиском по одному серверу с теми же документами.
+ */
+#include <algorithm>
+#include <execution>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "document.h"
+#include "query_arena.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+class ShardedSearchServer {
+public:
+    // stop_words — то же, что принимают конструкторы SearchServer
+    template<typename StopWords>
+    ShardedSearchServer(size_t shard_count, const StopWords &stop_words);
+
+    void AddDocument(int document_id, std::string_view document,
+            DocumentStatus status, const std::vector<int> &ratings);
+    void RemoveDocument(int document_id);
+
+    void SetMaxResultDocumentCount(size_t count);
+    size_t GetMaxResultDocumentCount() const;
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t index) const;
+    // Индекс шарда, которому принадлежит документ
+    size_t GetShardIndex(int document_id) const;
+
+    template<typename Filter>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            Filter filter_fun) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+            DocumentStatus find_status) const;
+
+    // Представления указывают в словарь шарда документа
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::string_view raw_query, int document_id) const;
+
+private:
+    std::vector<SearchServer> shards_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    // Разбирает запрос и считает IDF плюс-слов по всем шардам
+    SearchServer::Query ParseQuery(std::string_view raw_query,
+            std::pmr::memory_resource *resource) const;
+};
+
+template<typename StopWords>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count,
+        const StopWords &stop_words) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Количество шардов должно быть больше нуля.");
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template<typename Filter>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+        std::string_view raw_query, Filter filter_fun) const {
+    const QueryArena arena;
+    const SearchServer::Query query = ParseQuery(raw_query, arena.Resource());
+    // Каждый шард отбирает не больше max_result_document_count_ документов,
+    // поэтому общие лучшие документы есть среди лучших документов шардов
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(),
+            shard_documents.begin(),
+            [&query, &filter_fun](const SearchServer &shard) {
+                return shard.FindAllDocuments(query, filter_fun);
+            });
+
+    TopDocuments top_documents(max_result_document_count_);
+    for (const std::vector<Document> &documents : shard_documents) {
+        for (const Document &document : documents) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
@@ -0,0 +1,283 @@
+/*
+ * snapshot.cpp
+ */
+#include "snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+IndexSnapshot::IndexSnapshot(const string &path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть файл снимка `"s + path + "`."s);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error("Не удалось прочитать файл снимка `"s + path + "`."s);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw invalid_argument("Файл `"s + path + "` не является снимком."s);
+    }
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw runtime_error(
+                "Не удалось отобразить в память файл снимка `"s + path + "`."s);
+    }
+    data_ = static_cast<const char*>(data);
+    try {
+        Validate(path);
+    } catch (...) {
+        munmap(const_cast<char*>(data_), size_);
+        throw;
+    }
+}
+
+IndexSnapshot::~IndexSnapshot() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+template<typename T>
+const T* IndexSnapshot::Section(uint64_t offset, uint64_t count,
+        const string &path) const {
+    if (offset % alignof(T) != 0 || offset > size_
+            || count > (size_ - offset) / sizeof(T)) {
+        throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+    }
+    return At<T>(offset);
+}
+
+void IndexSnapshot::Validate(const string &path) const {
+    const SnapshotHeader &header = Header();
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw invalid_argument("Файл `"s + path + "` не является снимком."s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw invalid_argument(
+                "Версия снимка `"s + path + "` не поддерживается."s);
+    }
+    if (header.file_size != size_) {
+        throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+    }
+
+    const uint64_t *stop_offsets = Section<uint64_t>(header.stop_words_offset,
+            header.stop_word_count + 1, path);
+    const uint64_t stop_chars_size = stop_offsets[header.stop_word_count];
+    Section<char>(header.stop_word_chars_offset, stop_chars_size, path);
+    for (uint64_t i = 0; i < header.stop_word_count; ++i) {
+        if (stop_offsets[i] > stop_offsets[i + 1]) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+
+    const SnapshotWordEntry *words = Section<SnapshotWordEntry>(
+            header.words_offset, header.word_count, path);
+    const PostingBlock *blocks = Section<PostingBlock>(
+            header.posting_blocks_offset, header.posting_block_count, path);
+    Section<uint8_t>(header.posting_data_offset, header.posting_data_size, path);
+    if (header.posting_data_size < POSTING_DATA_PADDING) {
+        throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+    }
+    // Распаковка читает блоки без проверок, поэтому здесь проверяется,
+    // что каждый блок целиком лежит в секции данных
+    const uint64_t data_limit = header.posting_data_size - POSTING_DATA_PADDING;
+    for (uint64_t i = 0; i < header.word_count; ++i) {
+        Section<char>(header.word_chars_offset + words[i].chars_offset,
+                words[i].chars_size, path);
+        const SnapshotWordEntry &word = words[i];
+        if (word.blocks_begin > header.posting_block_count
+                || word.block_count
+                        > header.posting_block_count - word.blocks_begin
+                || word.data_begin > data_limit) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+        uint64_t postings_size = 0;
+        for (uint64_t j = word.blocks_begin;
+                j < word.blocks_begin + word.block_count; ++j) {
+            const PostingBlock &block = blocks[j];
+            if (block.size == 0 || block.size > POSTING_BLOCK_SIZE
+                    || block.id_bits > 32 || block.count_bits > 32
+                    || block.length_bits > 32
+                    || block.offset > data_limit - word.data_begin
+                    || PostingBlockBytes(block)
+                            > data_limit - word.data_begin - block.offset) {
+                throw invalid_argument(
+                        "Файл снимка `"s + path + "` повреждён."s);
+            }
+            postings_size += block.size;
+        }
+        if (postings_size != word.postings_size) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+
+    const SnapshotDocumentEntry *documents = Section<SnapshotDocumentEntry>(
+            header.documents_offset, header.document_count, path);
+    const uint32_t *forward_words = Section<uint32_t>(
+            header.forward_words_offset, header.forward_count, path);
+    Section<double>(header.forward_freqs_offset, header.forward_count, path);
+    Section<int32_t>(header.insert_order_offset, header.document_count, path);
+    for (uint64_t i = 0; i < header.document_count; ++i) {
+        if (documents[i].forward_begin > header.forward_count
+                || documents[i].forward_size
+                        > header.forward_count - documents[i].forward_begin) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+    for (uint64_t i = 0; i < header.forward_count; ++i) {
+        if (forward_words[i] >= header.word_count) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+
+    // Поиск слов и документов двоичный, а перенос индекса в память
+    // берёт документы порядка вставки из таблицы документов, поэтому
+    // таблицы должны быть строго упорядочены, а порядок вставки — быть
+    // перестановкой документов
+    for (uint64_t i = 1; i < header.word_count; ++i) {
+        if (!(Word(i - 1) < Word(i))) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+    for (uint64_t i = 0; i < header.document_count; ++i) {
+        if (documents[i].id < 0
+                || (i > 0 && documents[i - 1].id >= documents[i].id)) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+        const uint32_t *words_begin = forward_words + documents[i].forward_begin;
+        const uint32_t *words_end = words_begin + documents[i].forward_size;
+        if (adjacent_find(words_begin, words_end, greater_equal<uint32_t>())
+                != words_end) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+    }
+    vector<bool> inserted(header.document_count);
+    for (uint64_t i = 0; i < header.document_count; ++i) {
+        const SnapshotDocumentEntry *document = FindDocument(InsertOrder(i));
+        if (document == nullptr || inserted[document - documents]) {
+            throw invalid_argument("Файл снимка `"s + path + "` повреждён."s);
+        }
+        inserted[document - documents] = true;
+    }
+}
+
+const SnapshotHeader& IndexSnapshot::Header() const {
+    return *At<SnapshotHeader>(0);
+}
+
+string_view IndexSnapshot::Bytes() const {
+    return string_view(data_, size_);
+}
+
+size_t IndexSnapshot::StopWordCount() const {
+    return Header().stop_word_count;
+}
+
+string_view IndexSnapshot::StopWord(size_t index) const {
+    const uint64_t *offsets = At<uint64_t>(Header().stop_words_offset);
+    return string_view(At<char>(Header().stop_word_chars_offset) + offsets[index],
+            offsets[index + 1] - offsets[index]);
+}
+
+size_t IndexSnapshot::WordCount() const {
+    return Header().word_count;
+}
+
+string_view IndexSnapshot::Word(size_t index) const {
+    const SnapshotWordEntry &entry = WordEntry(index);
+    return string_view(At<char>(Header().word_chars_offset) + entry.chars_offset,
+            entry.chars_size);
+}
+
+const SnapshotWordEntry& IndexSnapshot::WordEntry(size_t index) const {
+    return At<SnapshotWordEntry>(Header().words_offset)[index];
+}
+
+size_t IndexSnapshot::FindWord(string_view word) const {
+    size_t left = 0;
+    size_t right = WordCount();
+    while (left < right) {
+        const size_t middle = left + (right - left) / 2;
+        if (Word(middle) < word) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    if (left < WordCount() && Word(left) == word) {
+        return left;
+    }
+    return WordCount();
+}
+
+const PostingBlock* IndexSnapshot::PostingBlocks() const {
+    return At<PostingBlock>(Header().posting_blocks_offset);
+}
+
+const uint8_t* IndexSnapshot::PostingData() const {
+    return At<uint8_t>(Header().posting_data_offset);
+}
+
+size_t IndexSnapshot::DocumentCount() const {
+    return Header().document_count;
+}
+
+const SnapshotDocumentEntry& IndexSnapshot::DocumentAt(size_t index) const {
+    return At<SnapshotDocumentEntry>(Header().documents_offset)[index];
+}
+
+const SnapshotDocumentEntry* IndexSnapshot::FindDocument(int document_id) const {
+    const SnapshotDocumentEntry *begin = At<SnapshotDocumentEntry>(
+            Header().documents_offset);
+    const SnapshotDocumentEntry *end = begin + DocumentCount();
+    const SnapshotDocumentEntry *it = lower_bound(begin, end, document_id,
+            [](const SnapshotDocumentEntry &entry, int id) {
+                return entry.id < id;
+            });
+    if (it == end || it->id != document_id) {
+        return nullptr;
+    }
+    return it;
+}
+
+int32_t IndexSnapshot::InsertOrder(size_t index) const {
+    return At<int32_t>(Header().insert_order_offset)[index];
+}
+
+const uint32_t* IndexSnapshot::ForwardWords() const {
+    return At<uint32_t>(Header().forward_words_offset);
+}
+
+const double* IndexSnapshot::ForwardFreqs() const {
+    return At<double>(Header().forward_freqs_offset);
+}
+
+const map<string_view, double>& IndexSnapshot::WordFrequencies(
+        int document_id) const {
+    static const map<string_view, double> empty_word_freqs;
+    const SnapshotDocumentEntry *document = FindDocument(document_id);
+    if (document == nullptr) {
+        return empty_word_freqs;
+    }
+
+    lock_guard guard(word_freqs_mutex_);
+    auto [it, inserted] = word_freqs_.try_emplace(document_id);
+    if (inserted) {
+        for (uint64_t i = document->forward_begin;
+                i < document->forward_begin + document->forward_size; ++i) {
+            it->second.emplace(Word(ForwardWords()[i]), ForwardFreqs()[i]);
+        }
+    }
+    return it->second;
+}
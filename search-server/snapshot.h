@@ -0,0 +1,136 @@
+#pragma once
+/*
+ * snapshot.h
+ *
+ *  Двоичный снимок индекса поискового сервера. Файл отображается в память
+ *  целиком, запросы читают словарь и списки вхождений прямо из отображения.
+ *
+ *  Формат (все секции выровнены на 8 байт, порядок байт — родной):
+ *    SnapshotHeader
+ *    стоп-слова:       uint64 offsets[stop_word_count + 1], затем символы
+ *    словарь:          SnapshotWordEntry[word_count], отсортирован по слову
+ *    символы слов:     char[]
+ *    вхождения:        PostingBlock blocks[posting_block_count],
+ *                      uint8 data[posting_data_size] — сжатые блоки списков
+ *                      (compressed_postings.h), в конце POSTING_DATA_PADDING нулей
+ *    документы:        SnapshotDocumentEntry[document_count], по возрастанию id
+ *    прямой индекс:    uint32 word_indexes[forward_count],
+ *                      double term_freqs[forward_count]
+ *    порядок вставки:  int32 document_ids[document_count]
+ */
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "compressed_postings.h"
+
+static_assert(std::is_same_v<int32_t, int>,
+        "Snapshot format stores document ids as int32");
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 3;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t max_result_document_count;
+    uint64_t file_size;
+    uint64_t stop_word_count;
+    uint64_t word_count;
+    uint64_t posting_count;
+    uint64_t posting_block_count;
+    uint64_t posting_data_size;
+    uint64_t document_count;
+    uint64_t forward_count;
+    uint64_t stop_words_offset;
+    uint64_t stop_word_chars_offset;
+    uint64_t words_offset;
+    uint64_t word_chars_offset;
+    uint64_t posting_blocks_offset;
+    uint64_t posting_data_offset;
+    uint64_t documents_offset;
+    uint64_t forward_words_offset;
+    uint64_t forward_freqs_offset;
+    uint64_t insert_order_offset;
+};
+
+struct SnapshotWordEntry {
+    uint64_t chars_offset;
+    uint64_t chars_size;
+    // Блоки списка и начало его данных внутри секции вхождений
+    uint64_t blocks_begin;
+    uint64_t block_count;
+    uint64_t data_begin;
+    uint64_t postings_size;
+    double log_document_freq;
+    double max_term_freq;
+};
+
+struct SnapshotDocumentEntry {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    uint32_t reserved;
+    uint64_t forward_begin;
+    uint64_t forward_size;
+};
+
+// Отображённый в память файл снимка. Только для чтения, потокобезопасен.
+class IndexSnapshot {
+public:
+    explicit IndexSnapshot(const std::string &path);
+    ~IndexSnapshot();
+
+    IndexSnapshot(const IndexSnapshot&) = delete;
+    IndexSnapshot& operator=(const IndexSnapshot&) = delete;
+
+    const SnapshotHeader& Header() const;
+    // Содержимое файла целиком
+    std::string_view Bytes() const;
+
+    size_t StopWordCount() const;
+    std::string_view StopWord(size_t index) const;
+
+    size_t WordCount() const;
+    std::string_view Word(size_t index) const;
+    const SnapshotWordEntry& WordEntry(size_t index) const;
+    // Индекс слова в словаре или WordCount(), если слова нет
+    size_t FindWord(std::string_view word) const;
+
+    const PostingBlock* PostingBlocks() const;
+    const uint8_t* PostingData() const;
+
+    size_t DocumentCount() const;
+    const SnapshotDocumentEntry& DocumentAt(size_t index) const;
+    // nullptr, если документа нет в снимке
+    const SnapshotDocumentEntry* FindDocument(int document_id) const;
+    int32_t InsertOrder(size_t index) const;
+
+    const uint32_t* ForwardWords() const;
+    const double* ForwardFreqs() const;
+
+    // Частоты слов документа; словарь строится при первом обращении
+    // и живёт вместе со снимком
+    const std::map<std::string_view, double>& WordFrequencies(
+            int document_id) const;
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+
+    mutable std::mutex word_freqs_mutex_;
+    mutable std::map<int, std::map<std::string_view, double>> word_freqs_;
+
+    template<typename T>
+    const T* Section(uint64_t offset, uint64_t count,
+            const std::string &path) const;
+    void Validate(const std::string &path) const;
+
+    template<typename T>
+    const T* At(uint64_t offset) const {
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+};
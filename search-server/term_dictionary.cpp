@@ -0,0 +1,98 @@
+/*
+ * term_dictionary.cpp
+ */
+#include "term_dictionary.h"
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_SLOT_COUNT = 64;
+
+}  // namespace
+
+uint32_t TermDictionary::Find(string_view term) const {
+    if (slots_.Empty()) {
+        return NO_TERM;
+    }
+    return slots_[FindSlot(term, Hash(term))].term_id;
+}
+
+uint32_t TermDictionary::Add(string_view term) {
+    if (slots_.Empty()) {
+        Rehash(INITIAL_SLOT_COUNT);
+    }
+    const uint32_t hash = Hash(term);
+    size_t index = FindSlot(term, hash);
+    // Известное слово не меняет ячейки, и их общие с копией части
+    // не копируются
+    if (slots_[index].term_id != NO_TERM) {
+        return slots_[index].term_id;
+    }
+    if ((terms_.Size() + 1) * 2 > slots_.Size()) {
+        Rehash(max(INITIAL_SLOT_COUNT, slots_.Size() * 2));
+        index = FindSlot(term, hash);
+    }
+
+    if (!storage_ || storage_.use_count() > 1) {
+        // Хранилище разделено с копией словаря — дописываем в новое
+        auto storage = make_shared<TermStorage>();
+        storage->previous = move(storage_);
+        storage_ = move(storage);
+    }
+    const uint32_t term_id = static_cast<uint32_t>(terms_.Size());
+    slots_.Mutable(index) = { term_id, hash };
+    terms_.PushBack(storage_->terms.emplace_back(term));
+    stop_words_.PushBack(0);
+    return term_id;
+}
+
+string_view TermDictionary::Term(uint32_t term_id) const {
+    return terms_[term_id];
+}
+
+size_t TermDictionary::Size() const {
+    return terms_.Size();
+}
+
+bool TermDictionary::IsStopWord(uint32_t term_id) const {
+    return stop_words_[term_id] != 0;
+}
+
+void TermDictionary::MarkStopWord(uint32_t term_id) {
+    stop_words_.Mutable(term_id) = 1;
+}
+
+uint32_t TermDictionary::Hash(string_view term) {
+    return static_cast<uint32_t>(hash<string_view>()(term));
+}
+
+size_t TermDictionary::FindSlot(string_view term, uint32_t hash) const {
+    const size_t mask = slots_.Size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const Slot &slot = slots_[index];
+        if (slot.term_id == NO_TERM
+                || (slot.hash == hash && terms_[slot.term_id] == term)) {
+            return index;
+        }
+    }
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    // Хеши хранятся в ячейках, строки заново не хешируются
+    const ChunkedVector<Slot> old_slots = move(slots_);
+    slots_.Assign(slot_count, Slot());
+    const size_t mask = slot_count - 1;
+    for (size_t old_index = 0; old_index < old_slots.Size(); ++old_index) {
+        const Slot &slot = old_slots[old_index];
+        if (slot.term_id == NO_TERM) {
+            continue;
+        }
+        size_t index = slot.hash & mask;
+        while (slots_[index].term_id != NO_TERM) {
+            index = (index + 1) & mask;
+        }
+        slots_.Mutable(index) = slot;
+    }
+}
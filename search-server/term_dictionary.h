@@ -0,0 +1,60 @@
+#pragma once
+/*
+ * term_dictionary.h
+ *
+ *  Словарь терминов: каждому слову — плотный идентификатор uint32_t в порядке
+ *  добавления. Поиск — открытая адресация с линейным пробированием; ячейка
+ *  хранит идентификатор и хеш слова, поэтому строки сравниваются только при
+ *  совпадении хешей. Стоп-слова — флаг термина в том же словаре.
+ *  Массивы словаря — ChunkedVector, копия словаря разделяет их части.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "chunked_vector.h"
+
+class TermDictionary {
+public:
+    static constexpr uint32_t NO_TERM = std::numeric_limits<uint32_t>::max();
+
+    // NO_TERM, если слова нет в словаре
+    uint32_t Find(std::string_view term) const;
+    // Идентификатор слова; новое слово добавляется в словарь
+    uint32_t Add(std::string_view term);
+    // Строка словаря, действительна, пока жив словарь или его копия
+    std::string_view Term(uint32_t term_id) const;
+    size_t Size() const;
+
+    bool IsStopWord(uint32_t term_id) const;
+    void MarkStopWord(uint32_t term_id);
+
+private:
+    struct Slot {
+        uint32_t term_id = NO_TERM;
+        uint32_t hash = 0;
+    };
+
+    // Строки терминов. Только дописываются и не перемещаются; хранилище,
+    // общее с копией словаря, не меняется — новые строки идут в новое,
+    // которое держит предыдущее
+    struct TermStorage {
+        std::shared_ptr<const TermStorage> previous;
+        std::deque<std::string> terms;
+    };
+
+    std::shared_ptr<TermStorage> storage_;
+    ChunkedVector<std::string_view> terms_;
+    ChunkedVector<uint8_t> stop_words_;
+    // Размер — степень двойки, заполнено не больше половины ячеек
+    ChunkedVector<Slot> slots_;
+
+    static uint32_t Hash(std::string_view term);
+    // Ячейка слова или пустая ячейка, где оно должно лежать
+    size_t FindSlot(std::string_view term, uint32_t hash) const;
+    void Rehash(size_t slot_count);
+};
@@ -0,0 +1,66 @@
+/*
+ * top_documents.cpp
+ */
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool IsMoreRelevant(const Document &lhs, const Document &rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+TopDocuments::TopDocuments(size_t capacity,
+        const optional<SearchAfter> &after) :
+        capacity_(capacity) {
+    if (after) {
+        after_ = Document(after->id, after->relevance, after->rating);
+    }
+    heap_.reserve(capacity);
+}
+
+void TopDocuments::Push(const Document &document) {
+    if (after_ && !IsMoreRelevant(*after_, document)) {
+        return;
+    }
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    } else if (capacity_ > 0 && IsMoreRelevant(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments &other) {
+    for (const Document &document : other.heap_) {
+        Push(document);
+    }
+}
+
+bool TopDocuments::IsFull() const {
+    return heap_.size() >= capacity_;
+}
+
+size_t TopDocuments::Size() const {
+    return heap_.size();
+}
+
+const Document& TopDocuments::Worst() const {
+    return heap_.front();
+}
+
+vector<Document> TopDocuments::Extract() {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    vector<Document> result;
+    result.swap(heap_);
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+/*
+ * top_documents.h
+ *
+ *  Отбор K самых релевантных документов без сортировки всех кандидатов.
+ */
+#include <optional>
+#include <vector>
+#include "document.h"
+
+const double EPSILON = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной релевантности —
+// по убыванию рейтинга, затем по возрастанию идентификатора
+bool IsMoreRelevant(const Document &lhs, const Document &rhs);
+
+// Ограниченная куча на capacity элементов. В вершине кучи лежит худший
+// из отобранных документов, поэтому каждый новый кандидат сравнивается
+// только с ним и обходится в O(log K).
+class TopDocuments {
+public:
+    // Если задан after, документы не после него в порядке выдачи отбрасываются
+    explicit TopDocuments(size_t capacity,
+            const std::optional<SearchAfter> &after = std::nullopt);
+
+    void Push(const Document &document);
+    void Merge(const TopDocuments &other);
+
+    bool IsFull() const;
+    size_t Size() const;
+    // Худший из отобранных документов, куча не должна быть пустой
+    const Document& Worst() const;
+
+    // Возвращает отобранные документы в порядке выдачи и очищает кучу
+    std::vector<Document> Extract();
+
+private:
+    size_t capacity_;
+    std::optional<Document> after_;
+    std::vector<Document> heap_;
+};
@@ -3,14 +3,35 @@
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <iostream>
 #include <vector>
+#include <stdexcept>
 #include <numeric>
+#include <execution>
+#include <fstream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <future>
+#include <sstream>
+#include <iterator>
+#include <limits>
+#include <filesystem>
 #include "search_server.h"
+#include "chunked_vector.h"
 #include "unit_test.h"
 #include "request_queue.h"
 #include "paginator.h"
+#include "process_queries.h"
+#include "live_search_server.h"
+#include "document_bitmap.h"
+#include "document_table.h"
+#include "sharded_search_server.h"
+#include "term_dictionary.h"
+#include "query_arena.h"
 
 using namespace std;
 
@@ -129,6 +150,11 @@ void TestQueue() {
     // Стек вызовов
     SearchServer search_server("and in at"s);
     RequestQueue request_queue(search_server);
+    // Каждый запрос приходит в свою минуту
+    int minute = 0;
+    request_queue.SetTimeSource([&minute] {
+        return RequestQueue::Clock::time_point(chrono::minutes(minute));
+    });
     search_server.AddDocument(1, "curly cat curly tail"s,
             DocumentStatus::ACTUAL, { 7, 2, 7 });
     search_server.AddDocument(2, "curly dog and fancy collar"s,
@@ -142,15 +168,18 @@ void TestQueue() {
     // 1439 запросов с нулевым результатом
     for (int i = 0; i < 1439; ++i) {
         request_queue.AddFindRequest("empty request"s);
+        ++minute;
     }
     // все еще 1439 запросов с нулевым результатом
     request_queue.AddFindRequest("curly dog"s);
+    ++minute;
     // новые сутки, первый запрос удален, 1438 запросов с нулевым результатом
 
     request_queue.AddFindRequest("big collar"s);
     ASSERT_EQUAL_HINT(request_queue.GetNoResultRequests(), 1438,
             "Не правильно работает очередь запросов. Должно быть 1438 пустых результатов"s);
     // первый запрос удален, 1437 запросов с нулевым результатом
+    ++minute;
     request_queue.AddFindRequest("sparrow"s);
     ASSERT_EQUAL_HINT(request_queue.GetNoResultRequests(), 1437,
             "Не правильно работает очередь запросов. Должно быть 1437 пустых результатов"s);
@@ -253,11 +282,1729 @@ void TestFilterUserPredicateDoc() {
 
 }
 
+void TestUnorderedDocumentIds() {
+    SearchServer server;
+    server.AddDocument(7, "кот кот пёс"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "кот хвост"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(5, "пёс хвост"s, DocumentStatus::ACTUAL, { 3 });
+
+    const auto documents = server.FindTopDocuments("кот -хвост"s);
+    ASSERT_EQUAL_HINT(documents.size(), 1u,
+            "Минус-слово должно исключать документ, добавленный вне порядка."s);
+    ASSERT_EQUAL(documents[0].id, 7);
+
+    const auto [words, status] = server.MatchDocument("кот пёс"s, 5);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "пёс"s);
+    ASSERT_EQUAL(server.GetDocumentId(1), 2);
+}
+
+void TestParallelSearch() {
+    SearchServer server("and with"s);
+    const vector<string> words = { "funny"s, "pet"s, "nasty"s, "rat"s,
+            "curly"s, "hair"s, "big"s, "cat"s, "dog"s, "hamster"s };
+    for (int id = 0; id < 5000; ++id) {
+        string text;
+        for (int i = 0; i < 4; ++i) {
+            text += words[(id * 7 + i * i * 3 + id / 11) % words.size()] + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3),
+                { id % 17 });
+    }
+
+    const string query = "curly cat -hamster funny"s;
+    const auto seq_documents = server.FindTopDocuments(query);
+    const auto par_documents = server.FindTopDocuments(execution::par, query);
+    ASSERT_EQUAL(seq_documents.size(), par_documents.size());
+    for (size_t i = 0; i < seq_documents.size(); ++i) {
+        ASSERT_EQUAL(seq_documents[i].id, par_documents[i].id);
+        ASSERT_EQUAL(seq_documents[i].rating, par_documents[i].rating);
+        ASSERT_EQUAL_HINT(abs(seq_documents[i].relevance
+                - par_documents[i].relevance) < EPSILON, true,
+                "Релевантность параллельного поиска отличается."s);
+    }
+
+    const auto par_banned = server.FindTopDocuments(execution::par, query,
+            DocumentStatus::BANNED);
+    ASSERT_EQUAL(par_banned.size(),
+            server.FindTopDocuments(query, DocumentStatus::BANNED).size());
+    const auto par_even = server.FindTopDocuments(execution::par, query,
+            [](int document_id, DocumentStatus, int) {
+                return document_id % 2 == 0;
+            });
+    for (const Document &document : par_even) {
+        ASSERT_EQUAL(document.id % 2, 0);
+    }
+
+    for (int id : { 0, 1, 2, 3, 42 }) {
+        const auto [seq_words, seq_status] = server.MatchDocument(query, id);
+        const auto [par_words, par_status] = server.MatchDocument(
+                execution::par, query, id);
+        ASSERT_EQUAL(seq_words.size(), par_words.size());
+        for (size_t i = 0; i < seq_words.size(); ++i) {
+            ASSERT_EQUAL(seq_words[i], par_words[i]);
+        }
+        ASSERT_EQUAL(static_cast<int>(seq_status),
+                static_cast<int>(par_status));
+    }
+}
+
+void TestMaxResultDocumentCount() {
+    SearchServer server;
+    for (int id = 0; id < 100; ++id) {
+        const string text = id % 2 == 0 ? "кот пёс"s : "кот кот пёс хвост"s;
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 10 });
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(),
+            static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    server.SetMaxResultDocumentCount(30);
+    for (const auto &documents : { server.FindTopDocuments("кот хвост"s),
+            server.FindTopDocuments(execution::par, "кот хвост"s) }) {
+        ASSERT_EQUAL(documents.size(), 30u);
+        ASSERT_EQUAL_HINT(is_sorted(documents.begin(), documents.end(),
+                IsMoreRelevant), true,
+                "Документы должны идти в порядке убывания релевантности и рейтинга."s);
+        // Первые 50 нечётных документов релевантнее, среди них лучшие по рейтингу 9
+        ASSERT_EQUAL(documents[0].id % 2, 1);
+        ASSERT_EQUAL(documents[0].rating, 9);
+        ASSERT_EQUAL(documents[29].id % 2, 1);
+    }
+
+    server.SetMaxResultDocumentCount(1000);
+    ASSERT_EQUAL(server.FindTopDocuments("хвост"s).size(), 50u);
+    server.SetMaxResultDocumentCount(0);
+    ASSERT_EQUAL(server.FindTopDocuments("хвост"s).empty(), true);
+}
+
+void TestStringViewInput() {
+    const string stop_words = "  и   в на  "s;
+    SearchServer server { string_view(stop_words) };
+    {
+        string buffer = "xxx белый  кот и модный ошейник xxx"s;
+        const size_t begin = buffer.find(' ');
+        const size_t end = buffer.rfind(' ');
+        server.AddDocument(1, string_view(buffer).substr(begin, end - begin),
+                DocumentStatus::ACTUAL, { 1 });
+        // Переиспользуем буфер, словарь должен хранить собственные копии слов
+        buffer.assign(buffer.size(), '#');
+    }
+    server.AddDocument(2, "кот в сапогах"sv, DocumentStatus::ACTUAL, { 2 });
+
+    ASSERT_EQUAL(server.FindTopDocuments("кот -сапогах"sv).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("кот кот  белый"sv).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("в"sv).empty(), true);
+
+    const auto [words, status] = server.MatchDocument("ошейник белый белый"sv, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "белый"s);
+    ASSERT_EQUAL(words[1], "ошейник"s);
+
+    for (const string_view bad_query : { "кот -"sv, "кот --пёс"sv }) {
+        bool thrown = false;
+        try {
+            server.FindTopDocuments(bad_query);
+        } catch (const invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT_EQUAL_HINT(thrown, true, "Некорректный запрос должен отклоняться."s);
+    }
+}
+
+void TestRemoveDocument() {
+    SearchServer server("и в на"s);
+    SearchServer expected_server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL,
+            { 8, -3 });
+    server.AddDocument(1, "пушистый кот пушистый хвост"s,
+            DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s,
+            DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::ACTUAL,
+            { 9 });
+    expected_server.AddDocument(0, "белый кот и модный ошейник"s,
+            DocumentStatus::ACTUAL, { 8, -3 });
+    expected_server.AddDocument(2, "ухоженный пёс выразительные глаза"s,
+            DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+
+    const auto &word_freqs = server.GetWordFrequencies(1);
+    ASSERT_EQUAL(word_freqs.size(), 3u);
+    ASSERT_EQUAL_HINT(abs(word_freqs.at("пушистый"sv) - 0.5) < EPSILON, true,
+            "Не правильно считается частота слова в документе."s);
+
+    server.RemoveDocument(1);
+    server.RemoveDocument(execution::par, 3);
+    server.RemoveDocument(100);
+
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+    ASSERT_EQUAL(server.GetDocumentId(1), 2);
+    ASSERT_EQUAL(server.GetWordFrequencies(1).empty(), true);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый скворец"s).empty(), true);
+
+    const auto documents = server.FindTopDocuments("пушистый ухоженный кот"s);
+    const auto expected = expected_server.FindTopDocuments(
+            "пушистый ухоженный кот"s);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected[i].id);
+        ASSERT_EQUAL_HINT(abs(documents[i].relevance - expected[i].relevance)
+                < EPSILON, true, "После удаления IDF должен пересчитываться."s);
+    }
+
+    // Удалённый идентификатор можно использовать снова
+    server.AddDocument(1, "кот"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 2u);
+}
+
+void TestProcessQueries() {
+    SearchServer server("and with"s);
+    int id = 0;
+    for (const string &text : { "funny pet and nasty rat"s,
+            "funny pet with curly hair"s, "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s, "nasty rat with curly hair"s }) {
+        server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+    }
+    const vector<string> queries = { "nasty rat -not"s, "not very funny nasty pet"s,
+            "curly hair"s, "unknown"s };
+
+    const auto results = ProcessQueries(server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    vector<Document> expected_joined;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(results[i][j].id, expected[j].id);
+        }
+        expected_joined.insert(expected_joined.end(), expected.begin(),
+                expected.end());
+    }
+    ASSERT_EQUAL(results[3].empty(), true);
+
+    const auto joined = ProcessQueriesJoined(server, queries);
+    ASSERT_EQUAL(joined.size(), expected_joined.size());
+    for (size_t i = 0; i < joined.size(); ++i) {
+        ASSERT_EQUAL(joined[i].id, expected_joined[i].id);
+    }
+
+    // Ошибочный запрос не завершает программу, а бросается вызывающему
+    const vector<string> bad_queries = { "curly hair"s, "--bad"s, "nasty rat"s };
+    for (const bool is_joined : { false, true }) {
+        bool thrown = false;
+        try {
+            if (is_joined) {
+                ProcessQueriesJoined(server, bad_queries);
+            } else {
+                ProcessQueries(server, bad_queries);
+            }
+        } catch (const invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT_EQUAL(thrown, true);
+    }
+}
+
+void TestIdfUpdatesOnAddDocument() {
+    SearchServer server;
+    server.AddDocument(1, "кот"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL_HINT(abs(server.FindTopDocuments("кот"s)[0].relevance) < EPSILON,
+            true, "Слово, встречающееся во всех документах, имеет нулевой IDF."s);
+
+    server.AddDocument(2, "пёс"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "пёс хвост"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL_HINT(abs(server.FindTopDocuments("кот"s)[0].relevance
+            - log(3.)) < EPSILON, true,
+            "IDF должен учитывать новые документы."s);
+    ASSERT_EQUAL_HINT(abs(server.FindTopDocuments("хвост"s)[0].relevance
+            - log(3.) / 2) < EPSILON, true,
+            "Не правильно считается релевантность документа."s);
+}
+
+void TestSnapshot() {
+    const string path = "search_server_test.snapshot"s;
+    SearchServer server("и в на"s);
+    server.SetMaxResultDocumentCount(3);
+    server.AddDocument(4, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL,
+            { 8, -3 });
+    server.AddDocument(1, "пушистый кот пушистый хвост"s,
+            DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s,
+            DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::BANNED,
+            { 9 });
+    server.AddDocument(5, "одинокий ёж"s, DocumentStatus::ACTUAL, { 1 });
+    server.RemoveDocument(5);
+    server.SaveSnapshot(path);
+
+    SearchServer mapped = SearchServer::OpenSnapshot(path);
+    ASSERT_EQUAL(mapped.GetDocumentCount(), server.GetDocumentCount());
+    ASSERT_EQUAL(mapped.GetMaxResultDocumentCount(), 3u);
+    for (int index = 0; index < server.GetDocumentCount(); ++index) {
+        ASSERT_EQUAL(mapped.GetDocumentId(index), server.GetDocumentId(index));
+    }
+    for (const string &query : { "пушистый ухоженный кот"s, "кот -хвост"s,
+            "ёж"s, "и"s }) {
+        for (const auto &documents : { mapped.FindTopDocuments(query),
+                mapped.FindTopDocuments(execution::par, query) }) {
+            const auto expected = server.FindTopDocuments(query);
+            ASSERT_EQUAL(documents.size(), expected.size());
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL(documents[i].id, expected[i].id);
+                ASSERT_EQUAL(documents[i].rating, expected[i].rating);
+                ASSERT_EQUAL_HINT(abs(documents[i].relevance
+                        - expected[i].relevance) < EPSILON, true,
+                        "Релевантность по снимку отличается."s);
+            }
+        }
+    }
+    const auto [words, status] = mapped.MatchDocument("скворец евгений кот"s, 3);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "евгений"s);
+    ASSERT_EQUAL(static_cast<int>(status),
+            static_cast<int>(DocumentStatus::BANNED));
+    ASSERT_EQUAL(mapped.GetWordFrequencies(1).size(), 3u);
+    ASSERT_EQUAL(mapped.GetWordFrequencies(5).empty(), true);
+    const map<string_view, double> &mapped_freqs = mapped.GetWordFrequencies(1);
+
+    // Изменение переносит индекс в память, снимок остаётся нетронутым
+    mapped.AddDocument(6, "кот"s, DocumentStatus::ACTUAL, { 1 });
+    mapped.RemoveDocument(execution::par, 4);
+    // Выданные до переноса представления по-прежнему указывают в отображение
+    ASSERT_EQUAL(words[0], "евгений"s);
+    ASSERT_EQUAL(words[1], "скворец"s);
+    ASSERT_EQUAL(mapped_freqs.size(), 3u);
+    ASSERT_EQUAL(mapped_freqs.begin()->first, "кот"s);
+    ASSERT_EQUAL(mapped.GetDocumentCount(), 4);
+    ASSERT_EQUAL(mapped.FindTopDocuments("кот"s).size(), 2u);
+    ASSERT_EQUAL(SearchServer::OpenSnapshot(path).FindTopDocuments("кот"s).size(),
+            2u);
+    ASSERT_EQUAL(SearchServer::OpenSnapshot(path).GetWordFrequencies(4).size(),
+            4u);
+
+    // Сохранение отображённого снимка поверх его собственного файла
+    {
+        const SearchServer reopened = SearchServer::OpenSnapshot(path);
+        reopened.SaveSnapshot(path);
+        ASSERT_EQUAL(reopened.FindTopDocuments("кот"s).size(), 2u);
+        ASSERT_EQUAL(SearchServer::OpenSnapshot(path).GetDocumentCount(),
+                server.GetDocumentCount());
+    }
+
+    // Одновременные сохранения в один путь пишут разные временные файлы;
+    // по пути остаётся целый снимок, временных файлов не остаётся
+    {
+        vector<thread> savers;
+        for (int i = 0; i < 4; ++i) {
+            savers.emplace_back([&server, &path] {
+                for (int j = 0; j < 5; ++j) {
+                    server.SaveSnapshot(path);
+                }
+            });
+        }
+        for (thread &saver : savers) {
+            saver.join();
+        }
+        ASSERT_EQUAL(SearchServer::OpenSnapshot(path).GetDocumentCount(),
+                server.GetDocumentCount());
+        size_t temp_files = 0;
+        for (const filesystem::directory_entry &entry :
+                filesystem::directory_iterator("."s)) {
+            const string name = entry.path().filename().string();
+            temp_files += name.size() > path.size()
+                    && name.compare(0, path.size() + 1, path + "."s) == 0;
+        }
+        ASSERT_EQUAL(temp_files, 0u);
+    }
+
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << "not a snapshot at all, just some text that is long enough "s
+                << string(200, '#');
+    }
+    bool thrown = false;
+    try {
+        SearchServer::OpenSnapshot(path);
+    } catch (const invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_EQUAL_HINT(thrown, true, "Повреждённый снимок должен отклоняться."s);
+
+    // Испорченные таблицы документов, слов и порядка вставки
+    server.SaveSnapshot(path);
+    string bytes;
+    {
+        ifstream in(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    const SnapshotHeader header = *reinterpret_cast<const SnapshotHeader*>(
+            bytes.data());
+    auto expect_corrupted = [&](size_t offset, const string &patch) {
+        string corrupted = bytes;
+        corrupted.replace(offset, patch.size(), patch);
+        {
+            ofstream out(path, ios::binary | ios::trunc);
+            out << corrupted;
+        }
+        bool thrown = false;
+        try {
+            SearchServer::OpenSnapshot(path).AddDocument(100, "кот"s,
+                    DocumentStatus::ACTUAL, { 1 });
+        } catch (const invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT_EQUAL_HINT(thrown, true,
+                "Повреждённый снимок должен отклоняться."s);
+    };
+    auto as_bytes = [](int32_t value) {
+        return string(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    // Документа из порядка вставки нет в таблице документов
+    expect_corrupted(header.insert_order_offset, as_bytes(77));
+    // Документ вставлен дважды
+    expect_corrupted(header.insert_order_offset, as_bytes(
+            *reinterpret_cast<const int32_t*>(bytes.data()
+                    + header.insert_order_offset + sizeof(int32_t))));
+    // Документы не по возрастанию идентификаторов
+    expect_corrupted(header.documents_offset, as_bytes(3));
+    // Слова не по возрастанию: первая буква первого слова заменена на последнюю
+    const SnapshotWordEntry first_word =
+            *reinterpret_cast<const SnapshotWordEntry*>(bytes.data()
+                    + header.words_offset);
+    expect_corrupted(header.word_chars_offset + first_word.chars_offset,
+            "\xFF"s);
+    remove(path.c_str());
+}
+
+void TestQueryCache() {
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "пушистый кот пушистый хвост"s,
+            DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s,
+            DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.EnableQueryCache(1 << 20);
+
+    ASSERT_EQUAL(server.FindTopDocuments("кот пёс -глаза"s).size(), 1u);
+    // Тот же запрос с другим порядком слов, повтором и стоп-словом
+    ASSERT_EQUAL(server.FindTopDocuments("пёс и -глаза кот кот"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "кот пёс -глаза"s).size(),
+            1u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 2u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 1u);
+
+    // Другой статус — другой ключ
+    ASSERT_EQUAL(server.FindTopDocuments("кот пёс -глаза"s,
+            DocumentStatus::BANNED).empty(), true);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 2u);
+
+    // Изменение индекса делает старые записи недействительными
+    const uint64_t generation = server.GetGeneration();
+    server.AddDocument(3, "кот"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.GetGeneration() != generation, true);
+    ASSERT_EQUAL_HINT(server.FindTopDocuments("кот пёс -глаза"s).size(), 2u,
+            "Кэш не должен возвращать результат старой версии индекса."s);
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(server.FindTopDocuments("кот пёс -глаза"s).size(), 1u);
+
+    // Маленький кэш вытесняет старые записи
+    server.EnableQueryCache(400);
+    for (const string &query : { "кот"s, "пёс"s, "хвост"s, "глаза"s }) {
+        server.FindTopDocuments(query);
+    }
+    const QueryCache::Stats stats = server.GetQueryCacheStats();
+    ASSERT_EQUAL_HINT(stats.used_bytes <= 400u, true,
+            "Кэш не должен превышать заданный объём."s);
+    ASSERT_EQUAL(stats.entries < 4u, true);
+
+    server.DisableQueryCache();
+    RequestQueue request_queue(server, 1 << 20);
+    request_queue.AddFindRequest("кот"s);
+    request_queue.AddFindRequest("кот"s);
+    ASSERT_EQUAL(request_queue.GetQueryCacheStats().hits, 1u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 0u);
+}
+
 /*
  Разместите код остальных тестов здесь
  */
 
 // Функция TestSearchServer является точкой входа для запуска тестов
+void TestRequestQueueStats() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s,
+            DocumentStatus::ACTUAL, { 7, 2, 7 });
+    RequestQueue request_queue(search_server);
+    int minute = 0;
+    request_queue.SetTimeSource([&minute] {
+        return RequestQueue::Clock::time_point(chrono::minutes(minute));
+    });
+
+    // Несколько запросов в одну минуту попадают в одну ячейку
+    for (int i = 0; i < 60; ++i) {
+        request_queue.AddFindRequest("curly"s);
+        request_queue.AddFindRequest("dog"s);
+    }
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 120u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 60);
+    ASSERT_EQUAL(abs(request_queue.GetQps() - 2.) < EPSILON, true);
+    ASSERT_EQUAL(request_queue.GetLatencyHistogram().Total(), 120u);
+    ASSERT_EQUAL(request_queue.GetLatencyHistogram().PercentileUs(0.5) > 0u, true);
+
+    // Спустя минуту QPS считается уже по пустой текущей минуте
+    minute = 1;
+    ASSERT_EQUAL(abs(request_queue.GetQps()) < EPSILON, true);
+    ASSERT_EQUAL(abs(request_queue.GetQps(2) - 1.) < EPSILON, true);
+
+    // Запросы из нескольких потоков не теряются
+    {
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&request_queue] {
+                for (int i = 0; i < 250; ++i) {
+                    request_queue.AddFindRequest("dog"s);
+                }
+            });
+        }
+        for (thread &worker : threads) {
+            worker.join();
+        }
+    }
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 1120u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1060);
+
+    // Через сутки ячейки первой минуты больше не учитываются,
+    // а через двое — и второй; ячейки переиспользуются без сброса
+    minute = 1440;
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 1000u);
+    request_queue.AddFindRequest("dog"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1001);
+    minute = 1441 + 1440;
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 0u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+}
+
+void TestLiveSearchServer() {
+    // Копия сервера не меняется вместе с оригиналом и наоборот
+    {
+        SearchServer server("и в на"s);
+        server.AddDocument(1, "белый кот"s, DocumentStatus::ACTUAL, { 1 });
+        const SearchServer copy = server;
+        server.AddDocument(2, "чёрный кот"s, DocumentStatus::ACTUAL, { 2 });
+        server.RemoveDocument(1);
+        ASSERT_EQUAL(copy.GetDocumentCount(), 1);
+        ASSERT_EQUAL(copy.FindTopDocuments("кот"s).size(), 1u);
+        ASSERT_EQUAL(copy.FindTopDocuments("кот"s)[0].id, 1);
+        ASSERT_EQUAL(copy.GetWordFrequencies(1).size(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 1u);
+        ASSERT_EQUAL(server.FindTopDocuments("кот"s)[0].id, 2);
+    }
+
+    // Копия большого сервера разделяет с ним части таблиц, изменения
+    // оригинала в разных частях её не затрагивают
+    {
+        SearchServer server("и в на"s);
+        for (int id = 0; id < 3000; ++id) {
+            server.AddDocument(id, "слово"s + to_string(id) + " кот"s,
+                    DocumentStatus::ACTUAL, { id });
+        }
+        const SearchServer copy = server;
+        for (int id = 0; id < 3000; id += 7) {
+            server.RemoveDocument(id);
+        }
+        for (int id = 3000; id < 5000; ++id) {
+            server.AddDocument(id, "новое"s + to_string(id) + " кот"s,
+                    DocumentStatus::BANNED, { 1 });
+        }
+        ASSERT_EQUAL(copy.GetDocumentCount(), 3000);
+        ASSERT_EQUAL(copy.GetDocumentId(2999), 2999);
+        ASSERT_EQUAL(copy.FindTopDocuments("слово1400"s).size(), 1u);
+        ASSERT_EQUAL(copy.FindTopDocuments("слово1400"s)[0].rating, 1400);
+        ASSERT_EQUAL(copy.FindTopDocuments("новое4000"s,
+                DocumentStatus::BANNED).empty(), true);
+        ASSERT_EQUAL(copy.GetWordFrequencies(2100).count("слово2100"), 1u);
+        ASSERT_EQUAL(server.FindTopDocuments("слово1400"s).empty(), true);
+        ASSERT_EQUAL(server.FindTopDocuments("новое4000"s,
+                DocumentStatus::BANNED).size(), 1u);
+        ASSERT_EQUAL(server.GetWordFrequencies(2100).empty(), true);
+    }
+
+    SearchServer initial("и в на"s);
+    initial.SetMaxResultDocumentCount(10000);
+    LiveSearchServer live(move(initial));
+    live.AddDocument(0, "общий кот"s, DocumentStatus::ACTUAL, { 1 });
+    // До публикации читатели видят прежнюю версию
+    ASSERT_EQUAL(live.GetDocumentCount(), 0);
+    ASSERT_EQUAL(live.FindTopDocuments("кот"s).empty(), true);
+    live.Publish();
+    ASSERT_EQUAL(live.GetDocumentCount(), 1);
+    ASSERT_EQUAL(get<0>(live.MatchDocument("кот"s, 0)).size(), 1u);
+
+    // Читатели работают во время индексации и всегда видят согласованную
+    // версию: общее слово есть во всех документах версии
+    const int document_count = 2000;
+    atomic<bool> done = false;
+    atomic<bool> consistent = true;
+    vector<thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            int last_count = 0;
+            while (!done) {
+                live.Read([&](const SearchServer &server) {
+                    const int count = server.GetDocumentCount();
+                    if (static_cast<int>(server.FindTopDocuments("общий"s).size())
+                            != count || count < last_count) {
+                        consistent = false;
+                    }
+                    last_count = count;
+                });
+            }
+        });
+    }
+    for (int id = 1; id < document_count; ++id) {
+        live.AddDocument(id, "общий пёс номер"s + to_string(id),
+                DocumentStatus::ACTUAL, { id });
+        if (id % 100 == 0) {
+            live.Publish();
+        }
+        if (id % 250 == 0) {
+            live.RemoveDocument(id - 1);
+        }
+    }
+    live.Publish();
+    done = true;
+    for (thread &reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL_HINT(consistent.load(), true,
+            "Читатель увидел несогласованную версию индекса"s);
+    ASSERT_EQUAL(live.GetDocumentCount(), document_count - 7);
+    ASSERT_EQUAL(live.FindTopDocuments("пёс"s).size(),
+            static_cast<size_t>(document_count - 8));
+}
+
+void TestAddDocuments() {
+    // Пакет с неупорядоченными идентификаторами индексируется так же,
+    // как последовательные вызовы AddDocument
+    const vector<string> texts = { "белый кот и модный ошейник"s,
+            "пушистый кот пушистый хвост"s, "ухоженный пёс выразительные глаза"s,
+            "ухоженный скворец евгений"s };
+    const int document_count = 5000;
+    SearchServer sequential("и в на"s);
+    SearchServer bulk("и в на"s);
+    sequential.AddDocument(2500, texts[0], DocumentStatus::ACTUAL, { 1 });
+    bulk.AddDocument(2500, texts[0], DocumentStatus::ACTUAL, { 1 });
+    vector<SearchServer::DocumentToAdd> batch;
+    for (int i = 0; i < document_count; ++i) {
+        const int id = (i * 7919) % document_count;
+        if (id == 2500) {
+            continue;
+        }
+        const DocumentStatus status = static_cast<DocumentStatus>(id % 4);
+        sequential.AddDocument(id, texts[id % texts.size()], status,
+                { id % 10, 3 });
+        batch.push_back( { id, texts[id % texts.size()], status, { id % 10, 3 } });
+    }
+    bulk.AddDocuments(batch);
+    ASSERT_EQUAL(bulk.GetDocumentCount(), sequential.GetDocumentCount());
+    for (int index = 0; index < document_count; index += 97) {
+        ASSERT_EQUAL(bulk.GetDocumentId(index), sequential.GetDocumentId(index));
+    }
+    for (int id = 0; id < document_count; id += 101) {
+        ASSERT_EQUAL(bulk.GetWordFrequencies(id) == sequential.GetWordFrequencies(id),
+                true);
+    }
+    sequential.SetMaxResultDocumentCount(50);
+    bulk.SetMaxResultDocumentCount(50);
+    for (const string &query : { "кот -хвост"s, "ухоженный пёс"s, "скворец"s }) {
+        const vector<Document> expected = sequential.FindTopDocuments(query);
+        const vector<Document> actual = bulk.FindTopDocuments(query);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(abs(actual[i].relevance - expected[i].relevance) < EPSILON,
+                    true);
+        }
+    }
+
+    // Ошибочный пакет не добавляет ни одного документа
+    auto expect_rejected = [&bulk](const vector<SearchServer::DocumentToAdd> &documents) {
+        const int count = bulk.GetDocumentCount();
+        try {
+            bulk.AddDocuments(documents);
+            ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение invalid_argument"s);
+        } catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(bulk.GetDocumentCount(), count);
+    };
+    expect_rejected( { { 10000, "новый кот"s, DocumentStatus::ACTUAL, { 1 } }, {
+            10000, "новый пёс"s, DocumentStatus::ACTUAL, { 1 } } });
+    expect_rejected( { { 10001, "новый кот"s, DocumentStatus::ACTUAL, { 1 } }, {
+            2500, "новый пёс"s, DocumentStatus::ACTUAL, { 1 } } });
+    expect_rejected( { { 10002, "новый кот"s, DocumentStatus::ACTUAL, { 1 } }, {
+            10003, "новый п\x12ёс"s, DocumentStatus::ACTUAL, { 1 } } });
+    expect_rejected( { { -1, "новый кот"s, DocumentStatus::ACTUAL, { 1 } } });
+    ASSERT_EQUAL(bulk.FindTopDocuments("новый"s).empty(), true);
+}
+
+void TestCompressedPostings() {
+    // Списки из нескольких блоков: слово "все" есть в каждом документе,
+    // "чётный" — в чётных, "редкий" — в документах с номером, кратным 97
+    const int document_count = 1000;
+    SearchServer server;
+    server.SetMaxResultDocumentCount(document_count);
+    auto document_text = [](int id) {
+        string text = "все все"s;
+        if (id % 2 == 0) {
+            text += " чётный"s;
+        }
+        if (id % 97 == 0) {
+            text += " редкий"s;
+        }
+        return text + " номер"s + to_string(id);
+    };
+    // Сначала нечётные, потом чётные: вставки в середину сжатых блоков
+    for (int id = 1; id < document_count; id += 2) {
+        server.AddDocument(id, document_text(id), DocumentStatus::ACTUAL, { id });
+    }
+    for (int id = 0; id < document_count; id += 2) {
+        server.AddDocument(id, document_text(id), DocumentStatus::ACTUAL, { id });
+    }
+    server.RemoveDocument(500);
+    server.RemoveDocument(999);
+
+    auto check = [&](const SearchServer &checked) {
+        const vector<Document> all = checked.FindTopDocuments("все"s);
+        ASSERT_EQUAL(all.size(), static_cast<size_t>(document_count - 2));
+        const vector<Document> even = checked.FindTopDocuments("чётный -редкий"s);
+        ASSERT_EQUAL(even.size(), static_cast<size_t>(document_count / 2 - 1 - 6));
+        for (const Document &document : even) {
+            ASSERT_EQUAL(document.id % 2 == 0 && document.id % 97 != 0, true);
+        }
+        // Частота восстанавливается точно: 1 из 5 слов, слово в 11 документах
+        const vector<Document> rare = checked.FindTopDocuments("редкий"s);
+        ASSERT_EQUAL(rare.size(), 11u);
+        const auto it = find_if(rare.begin(), rare.end(),
+                [](const Document &document) {
+                    return document.id == 194;
+                });
+        ASSERT_EQUAL(it != rare.end(), true);
+        ASSERT_EQUAL(abs(it->relevance
+                - 1. / 5. * log(static_cast<double>(document_count - 2) / 11))
+                < EPSILON, true);
+        for (int id : { 0, 1, 2, 127, 128, 129, 194, 998 }) {
+            const auto [words, status] = checked.MatchDocument("чётный редкий"s, id);
+            const size_t expected = (id % 2 == 0 ? 1 : 0) + (id % 97 == 0 ? 1 : 0);
+            ASSERT_EQUAL(words.size(), expected);
+        }
+        ASSERT_EQUAL(get<0>(checked.MatchDocument("все"s, 500)).empty(), true);
+    };
+    check(server);
+
+    const string path = "search_server_test.snapshot"s;
+    server.SaveSnapshot(path);
+    {
+        const SearchServer mapped = SearchServer::OpenSnapshot(path);
+        check(mapped);
+        ASSERT_EQUAL(mapped.FindTopDocuments(execution::par, "чётный"s).size(),
+                static_cast<size_t>(document_count / 2 - 1));
+    }
+    // Изменение открытого снимка переносит сжатые блоки в память
+    SearchServer detached = SearchServer::OpenSnapshot(path);
+    detached.AddDocument(500, document_text(500), DocumentStatus::ACTUAL, { 1 });
+    detached.RemoveDocument(500);
+    check(detached);
+    remove(path.c_str());
+
+    // Удаления из сжатых блоков: последние документы блоков (следующий блок
+    // пересжимается от нового основания), целый блок, документы хвоста
+    SearchServer removed;
+    removed.SetMaxResultDocumentCount(document_count);
+    for (int id = 0; id < document_count; ++id) {
+        removed.AddDocument(id, document_text(id), DocumentStatus::ACTUAL,
+                { id });
+    }
+    set<int> expected_ids;
+    for (int id = 0; id < document_count; ++id) {
+        expected_ids.insert(id);
+    }
+    vector<int> removed_ids = { 127, 255, 0, 128, 998, 999, 500 };
+    for (int id = 256; id < 384; ++id) {
+        removed_ids.push_back(id);
+    }
+    for (int id = 1; id < document_count; id += 3) {
+        removed_ids.push_back(id);
+    }
+    for (int id : removed_ids) {
+        removed.RemoveDocument(id);
+        expected_ids.erase(id);
+    }
+    auto check_removed = [&](const SearchServer &checked) {
+        for (RetrievalMode mode : { RetrievalMode::EXHAUSTIVE,
+                RetrievalMode::MAX_SCORE }) {
+            SearchServer copy = checked;
+            copy.SetRetrievalMode(mode);
+            set<int> found_ids;
+            for (const Document &document : copy.FindTopDocuments("все"s)) {
+                found_ids.insert(document.id);
+            }
+            ASSERT_EQUAL(found_ids == expected_ids, true);
+            ASSERT_EQUAL(copy.FindTopDocuments("чётный редкий"s).size(),
+                    static_cast<size_t>(count_if(expected_ids.begin(),
+                            expected_ids.end(), [](int id) {
+                                return id % 2 == 0 || id % 97 == 0;
+                            })));
+        }
+        for (int id : { 126, 129, 254, 256, 384, 997 }) {
+            ASSERT_EQUAL(get<0>(checked.MatchDocument("все"s, id)).size(),
+                    expected_ids.count(id));
+        }
+    };
+    check_removed(removed);
+    removed.SaveSnapshot(path);
+    check_removed(SearchServer::OpenSnapshot(path));
+    remove(path.c_str());
+    // Удалённые идентификаторы добавляются снова
+    for (int id : { 127, 300, 998 }) {
+        removed.AddDocument(id, document_text(id), DocumentStatus::ACTUAL,
+                { id });
+        expected_ids.insert(id);
+    }
+    check_removed(removed);
+
+    // Документы по убыванию идентификаторов: каждая вставка пересжимает
+    // один блок, полный блок делится надвое
+    SearchServer descending;
+    descending.SetMaxResultDocumentCount(document_count);
+    const int descending_count = 600;
+    for (int id = descending_count - 1; id >= 0; --id) {
+        descending.AddDocument(id, document_text(id), DocumentStatus::ACTUAL,
+                { id });
+    }
+    for (RetrievalMode mode : { RetrievalMode::EXHAUSTIVE,
+            RetrievalMode::MAX_SCORE }) {
+        descending.SetRetrievalMode(mode);
+        const vector<Document> all = descending.FindTopDocuments("все"s);
+        ASSERT_EQUAL(all.size(), static_cast<size_t>(descending_count));
+        ASSERT_EQUAL(descending.FindTopDocuments("редкий"s).size(), 7u);
+    }
+    ASSERT_EQUAL(get<0>(descending.MatchDocument("чётный"s, 300)).size(), 1u);
+    descending.SaveSnapshot(path);
+    {
+        const IndexSnapshot snapshot(path);
+        const SnapshotWordEntry &entry = snapshot.WordEntry(
+                snapshot.FindWord("все"s));
+        ASSERT_EQUAL(entry.postings_size,
+                static_cast<uint64_t>(descending_count));
+        // Блоки заполнены не меньше чем наполовину
+        ASSERT_EQUAL(entry.block_count >= descending_count / POSTING_BLOCK_SIZE,
+                true);
+        ASSERT_EQUAL(entry.block_count <= descending_count * 2
+                / POSTING_BLOCK_SIZE + 1, true);
+        int previous_id = -1;
+        for (uint64_t i = 0; i < entry.block_count; ++i) {
+            const PostingBlock &block = snapshot.PostingBlocks()[entry.blocks_begin
+                    + i];
+            ASSERT_EQUAL(block.size > 0 && block.size <= POSTING_BLOCK_SIZE,
+                    true);
+            PostingEntry entries[POSTING_BLOCK_SIZE];
+            DecodePostingBlock(block, snapshot.PostingData() + entry.data_begin,
+                    previous_id, entries);
+            for (size_t j = 0; j < block.size; ++j) {
+                ASSERT_EQUAL(entries[j].document_id, previous_id + 1);
+                previous_id = entries[j].document_id;
+            }
+            ASSERT_EQUAL(block.last_document_id, previous_id);
+        }
+        ASSERT_EQUAL(previous_id, descending_count - 1);
+    }
+    remove(path.c_str());
+}
+
+void TestMaxScoreRetrieval() {
+    // Случайный корпус с частыми и редкими словами: MAX_SCORE должен
+    // выдавать те же документы с той же релевантностью, что и полный подсчёт
+    mt19937 generator(7);
+    const vector<string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s,
+            "скворец"s, "ёж"s, "глаза"s, "модный"s, "белый"s, "пушистый"s };
+    auto random_word = [&generator, &words]() {
+        // Первые слова встречаются гораздо чаще последних
+        const size_t index = min(words.size() - 1, static_cast<size_t>(
+                exponential_distribution<double>(0.5)(generator)));
+        return words[index];
+    };
+    SearchServer server("и в на"s);
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 8)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += random_word() + " "s;
+        }
+        server.AddDocument(id * 3 % 3001, text,
+                static_cast<DocumentStatus>(id % 4),
+                { uniform_int_distribution<int>(-3, 3)(generator) });
+    }
+    server.RemoveDocument(300);
+
+    auto compare = [](const vector<Document> &actual,
+            const vector<Document> &expected) {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            ASSERT_EQUAL_HINT(actual[i].relevance == expected[i].relevance, true,
+                    "Релевантность MAX_SCORE отличается от полного подсчёта"s);
+        }
+    };
+    for (size_t count : { 1u, 5u, 50u }) {
+        server.SetMaxResultDocumentCount(count);
+        for (int q = 0; q < 200; ++q) {
+            string query;
+            const int length = uniform_int_distribution<int>(1, 5)(generator);
+            for (int i = 0; i < length; ++i) {
+                if (i > 0 && q % 3 == 0) {
+                    query += "-"s;
+                }
+                query += random_word() + " "s;
+            }
+            server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+            const vector<Document> expected = server.FindTopDocuments(query);
+            const vector<Document> expected_filtered = server.FindTopDocuments(
+                    query, [](int document_id, DocumentStatus, int rating) {
+                        return document_id % 5 != 0 && rating >= 0;
+                    });
+            server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+            compare(server.FindTopDocuments(query), expected);
+            compare(server.FindTopDocuments(query,
+                    [](int document_id, DocumentStatus, int rating) {
+                        return document_id % 5 != 0 && rating >= 0;
+                    }), expected_filtered);
+        }
+    }
+
+    // Наибольший допустимый идентификатор находится в обоих режимах
+    for (const bool alone : { true, false }) {
+        SearchServer extreme;
+        if (!alone) {
+            extreme.AddDocument(5, "кот"s, DocumentStatus::ACTUAL, { 1 });
+        }
+        extreme.AddDocument(numeric_limits<int>::max(), "кот пёс"s,
+                DocumentStatus::ACTUAL, { 2 });
+        for (RetrievalMode mode : { RetrievalMode::EXHAUSTIVE,
+                RetrievalMode::MAX_SCORE }) {
+            extreme.SetRetrievalMode(mode);
+            const vector<Document> found = extreme.FindTopDocuments("кот пёс"s);
+            ASSERT_EQUAL(found.size(), alone ? 1u : 2u);
+            ASSERT_EQUAL(found[0].id, numeric_limits<int>::max());
+        }
+    }
+}
+
+void TestDocumentBitmap() {
+    {
+        DocumentBitmap bitmap;
+        ASSERT_EQUAL(bitmap.Empty(), true);
+        // Плотный контейнер, разреженный с большими идентификаторами,
+        // вставки не по порядку и повторы
+        for (int id = 0; id < 10000; id += 2) {
+            bitmap.Add(id);
+        }
+        for (int id : { 2000000000, 70000, 65536, 70000, 4 }) {
+            bitmap.Add(id);
+        }
+        ASSERT_EQUAL(bitmap.Size(), 5003u);
+        ASSERT_EQUAL(bitmap.Contains(9998), true);
+        ASSERT_EQUAL(bitmap.Contains(9999), false);
+        ASSERT_EQUAL(bitmap.Contains(10000), false);
+        ASSERT_EQUAL(bitmap.Contains(65536), true);
+        ASSERT_EQUAL(bitmap.Contains(65538), false);
+        ASSERT_EQUAL(bitmap.Contains(70000), true);
+        ASSERT_EQUAL(bitmap.Contains(2000000000), true);
+        ASSERT_EQUAL(bitmap.Contains(1999999999), false);
+        ASSERT_EQUAL(bitmap.Contains(-1), false);
+    }
+
+    // Минус-слова в нескольких блоках и в несжатом хвосте
+    SearchServer server("и в на"s);
+    for (int id = 0; id < 1000; ++id) {
+        const string text = id % 3 == 0 ? "кот хвост"s : "кот ошейник"s;
+        server.AddDocument(id * 1000, text, DocumentStatus::ACTUAL, { 1 });
+    }
+    server.SetMaxResultDocumentCount(1000);
+    for (RetrievalMode mode : { RetrievalMode::EXHAUSTIVE,
+            RetrievalMode::MAX_SCORE }) {
+        server.SetRetrievalMode(mode);
+        const vector<Document> found = server.FindTopDocuments("кот -хвост"s);
+        ASSERT_EQUAL(found.size(), 666u);
+        for (const Document &document : found) {
+            ASSERT_EQUAL(document.id / 1000 % 3 != 0, true);
+        }
+    }
+    const vector<Document> found = server.FindTopDocuments(execution::par,
+            "кот -хвост"s);
+    ASSERT_EQUAL(found.size(), 666u);
+    for (const Document &document : found) {
+        ASSERT_EQUAL(document.id / 1000 % 3 != 0, true);
+    }
+    for (int id : { 0, 1000, 128000, 129000, 999000, 998000 }) {
+        const bool excluded = id / 1000 % 3 == 0;
+        const auto [words, status] = server.MatchDocument("кот -хвост"s, id);
+        ASSERT_EQUAL(words.empty(), excluded);
+        const auto [par_words, par_status] = server.MatchDocument(
+                execution::par, "кот -хвост"s, id);
+        ASSERT_EQUAL(par_words.empty(), excluded);
+    }
+}
+
+void TestMatchDocumentForwardIndex() {
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL,
+            { 1 });
+    string long_text;
+    for (int i = 0; i < 200; ++i) {
+        long_text += "слово"s + to_string(i) + " "s;
+    }
+    server.AddDocument(2, long_text + "кот"s, DocumentStatus::BANNED, { 1 });
+
+    auto check = [](const SearchServer &server) {
+        vector<string_view> words;
+        {
+            // Слова указывают в словарь сервера, а не в строку запроса
+            const string query = "ошейник кот пёс белый белый"s;
+            words = get<0>(server.MatchDocument(query, 1));
+            ASSERT_EQUAL(words.size(), 3u);
+            for (string_view word : words) {
+                ASSERT_EQUAL(word.data() < query.data()
+                        || word.data() >= query.data() + query.size(), true);
+            }
+        }
+        ASSERT_EQUAL(words[0], "белый"s);
+        ASSERT_EQUAL(words[1], "кот"s);
+        ASSERT_EQUAL(words[2], "ошейник"s);
+        ASSERT_EQUAL(get<0>(server.MatchDocument("кот -модный"s, 1)).empty(),
+                true);
+
+        // Длинный запрос сливается со словами документа, короткий ищется
+        string long_query = "кот пёс"s;
+        for (int i = 0; i < 200; i += 3) {
+            long_query += " слово"s + to_string(i);
+        }
+        for (const string &query : { long_query, "слово5 слово6 кот"s }) {
+            const auto [seq_words, seq_status] = server.MatchDocument(query, 2);
+            const auto [par_words, par_status] = server.MatchDocument(
+                    execution::par, query, 2);
+            ASSERT_EQUAL(seq_words.size(), par_words.size());
+            for (size_t i = 0; i < seq_words.size(); ++i) {
+                ASSERT_EQUAL(seq_words[i], par_words[i]);
+            }
+            ASSERT_EQUAL(static_cast<int>(seq_status),
+                    static_cast<int>(DocumentStatus::BANNED));
+        }
+        ASSERT_EQUAL(get<0>(server.MatchDocument(long_query, 2)).size(), 68u);
+        ASSERT_EQUAL(get<0>(server.MatchDocument(long_query + " -слово199"s,
+                2)).empty(), true);
+        ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par,
+                "кот -слово0"s, 2)).empty(), true);
+    };
+    check(server);
+
+    const string path = "search_server_test.snapshot"s;
+    server.SaveSnapshot(path);
+    check(SearchServer::OpenSnapshot(path));
+    remove(path.c_str());
+}
+
+void TestShardedSearchServer() {
+    bool thrown = false;
+    try {
+        ShardedSearchServer empty(0, "и в на"s);
+    } catch (const invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_EQUAL(thrown, true);
+
+    mt19937 generator(11);
+    const vector<string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s,
+            "скворец"s, "ёж"s, "глаза"s, "модный"s, "белый"s, "пушистый"s };
+    SearchServer single("и в на"s);
+    ShardedSearchServer sharded(4, "и в на"s);
+    for (int id = 0; id < 2000; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 8)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += words[uniform_int_distribution<size_t>(0,
+                    words.size() - 1)(generator)] + " "s;
+        }
+        const DocumentStatus status = static_cast<DocumentStatus>(id % 4);
+        const vector<int> ratings = { uniform_int_distribution<int>(-3, 3)(
+                generator) };
+        single.AddDocument(id * 7, text, status, ratings);
+        sharded.AddDocument(id * 7, text, status, ratings);
+    }
+    single.RemoveDocument(70);
+    sharded.RemoveDocument(70);
+    ASSERT_EQUAL(sharded.GetDocumentCount(), single.GetDocumentCount());
+    for (size_t i = 0; i < sharded.GetShardCount(); ++i) {
+        ASSERT_EQUAL(sharded.GetShard(i).GetDocumentCount() > 0, true);
+    }
+
+    thrown = false;
+    try {
+        sharded.AddDocument(7, "кот"s, DocumentStatus::ACTUAL, { 1 });
+    } catch (const invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_EQUAL(thrown, true);
+
+    auto compare = [](const vector<Document> &actual,
+            const vector<Document> &expected) {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            ASSERT_EQUAL_HINT(actual[i].relevance == expected[i].relevance, true,
+                    "Релевантность шардов отличается от одного сервера"s);
+        }
+    };
+    for (size_t count : { 5u, 40u }) {
+        single.SetMaxResultDocumentCount(count);
+        sharded.SetMaxResultDocumentCount(count);
+        for (const string &query : { "кот"s, "пушистый ёж -хвост"s,
+                "модный белый глаза скворец"s, "нет_такого"s }) {
+            compare(sharded.FindTopDocuments(query),
+                    single.FindTopDocuments(query));
+            compare(sharded.FindTopDocuments(query, DocumentStatus::BANNED),
+                    single.FindTopDocuments(query, DocumentStatus::BANNED));
+            auto filter = [](int document_id, DocumentStatus, int rating) {
+                return document_id % 3 == 0 && rating > 0;
+            };
+            compare(sharded.FindTopDocuments(query, filter),
+                    single.FindTopDocuments(query, filter));
+        }
+    }
+
+    const auto [words_found, status] = sharded.MatchDocument("кот пёс"s, 14);
+    const auto [expected_words, expected_status] = single.MatchDocument(
+            "кот пёс"s, 14);
+    ASSERT_EQUAL(words_found.size(), expected_words.size());
+    ASSERT_EQUAL(static_cast<int>(status), static_cast<int>(expected_status));
+}
+
+void TestLazyPaginator() {
+    const vector<int> values = { 1, 2, 3, 4, 5, 6, 7 };
+    const auto pages = Paginate(values, 3);
+    ASSERT_EQUAL(pages.size(), 3u);
+    ASSERT_EQUAL(pages[0].size(), 3u);
+    ASSERT_EQUAL(pages[2].size(), 1u);
+    ASSERT_EQUAL(*pages[2].begin(), 7);
+    ASSERT_EQUAL(*pages[1].begin(), 4);
+    size_t total = 0;
+    for (const auto &page : pages) {
+        total += page.size();
+    }
+    ASSERT_EQUAL(total, values.size());
+
+    // Двунаправленные итераторы тоже подходят
+    const set<int> ordered(values.begin(), values.end());
+    const auto set_pages = Paginate(ordered, 7);
+    ASSERT_EQUAL(set_pages.size(), 1u);
+    ASSERT_EQUAL((*set_pages.begin()).size(), 7u);
+
+    const vector<Document> empty;
+    const auto empty_pages = Paginate(empty, 2);
+    ASSERT_EQUAL(empty_pages.empty(), true);
+    ASSERT_EQUAL(empty_pages.size(), 0u);
+    ASSERT_EQUAL(empty_pages.begin() == empty_pages.end(), true);
+
+    bool thrown = false;
+    try {
+        Paginate(values, 0);
+    } catch (const invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_EQUAL(thrown, true);
+}
+
+void TestSearchAfter() {
+    SearchServer server("и в на"s);
+    // Равная релевантность у многих документов: порядок решают рейтинг и id
+    for (int id = 0; id < 300; ++id) {
+        const string text = id % 5 == 0 ? "кот пёс"s : "кот"s;
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 2),
+                { id % 7 });
+    }
+    server.SetMaxResultDocumentCount(1000);
+    const vector<Document> all = server.FindTopDocuments("кот пёс -ёж"s);
+    ASSERT_EQUAL(all.size(), 150u);
+
+    server.SetMaxResultDocumentCount(7);
+    for (RetrievalMode mode : { RetrievalMode::EXHAUSTIVE,
+            RetrievalMode::MAX_SCORE }) {
+        server.SetRetrievalMode(mode);
+        vector<Document> paged = server.FindTopDocuments("кот пёс -ёж"s);
+        while (true) {
+            const vector<Document> page = server.FindTopDocumentsAfter(
+                    "кот пёс -ёж"s, SearchAfter(paged.back()));
+            if (page.empty()) {
+                break;
+            }
+            ASSERT_EQUAL(page.size() <= 7u, true);
+            paged.insert(paged.end(), page.begin(), page.end());
+        }
+        ASSERT_EQUAL(paged.size(), all.size());
+        for (size_t i = 0; i < all.size(); ++i) {
+            ASSERT_EQUAL(paged[i].id, all[i].id);
+        }
+    }
+
+    const vector<Document> banned = server.FindTopDocumentsAfter("кот"s,
+            SearchAfter(all[0]), DocumentStatus::IRRELEVANT);
+    ASSERT_EQUAL(banned.size(), 7u);
+    for (const Document &document : banned) {
+        ASSERT_EQUAL(document.id % 2, 1);
+    }
+    const vector<Document> filtered = server.FindTopDocumentsAfter("кот"s,
+            SearchAfter(all[3]), [](int document_id, DocumentStatus, int) {
+                return document_id % 3 == 0;
+            });
+    ASSERT_EQUAL(filtered.size(), 7u);
+    for (const Document &document : filtered) {
+        ASSERT_EQUAL(document.id % 3, 0);
+        ASSERT_EQUAL(IsMoreRelevant(all[3], document), true);
+    }
+}
+
+void TestTermDictionary() {
+    TermDictionary dictionary;
+    ASSERT_EQUAL(dictionary.Find("кот"s), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(dictionary.Add("кот"s), 0u);
+    ASSERT_EQUAL(dictionary.Add("пёс"s), 1u);
+    ASSERT_EQUAL(dictionary.Add("кот"s), 0u);
+    ASSERT_EQUAL(dictionary.Find(""s), TermDictionary::NO_TERM);
+
+    // Несколько перестроений таблицы
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQUAL(dictionary.Add("слово"s + to_string(i)),
+                static_cast<uint32_t>(i + 2));
+    }
+    ASSERT_EQUAL(dictionary.Size(), 1002u);
+    for (int i = 0; i < 1000; ++i) {
+        const uint32_t term_id = dictionary.Find("слово"s + to_string(i));
+        ASSERT_EQUAL(term_id, static_cast<uint32_t>(i + 2));
+        ASSERT_EQUAL(dictionary.Term(term_id), "слово"s + to_string(i));
+    }
+
+    // Копия разделяет строки, новые слова не видны другой стороне
+    const string_view cat = dictionary.Term(0);
+    TermDictionary copy = dictionary;
+    copy.MarkStopWord(copy.Add("и"s));
+    dictionary.Add("ёж"s);
+    ASSERT_EQUAL(copy.Term(0).data() == cat.data(), true);
+    ASSERT_EQUAL(copy.Find("ёж"s), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(dictionary.Find("и"s), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(copy.Find("и"s), dictionary.Find("ёж"s));
+    ASSERT_EQUAL(copy.IsStopWord(copy.Find("и"s)), true);
+    ASSERT_EQUAL(dictionary.IsStopWord(dictionary.Find("ёж"s)), false);
+
+    // Стоп-слова живут в словаре сервера без списков вхождений
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "кот и пёс"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "ёж на пне"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("и"s).empty(), true);
+    ASSERT_EQUAL(server.FindTopDocuments("кот ёж -и"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "кот ёж -на"s).size(),
+            2u);
+    ASSERT_EQUAL(server.GetWordFrequencies(2).size(), 2u);
+    ASSERT_EQUAL(server.GetWordFrequencies(2).at("пне"s), 0.5);
+    const auto [words, status] = server.MatchDocument("пёс и кот -в"s, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "кот"s);
+    ASSERT_EQUAL(words[1], "пёс"s);
+}
+
+// Ресурс, который считает выделения и берёт память у upstream
+class CountingResource: public pmr::memory_resource {
+public:
+    explicit CountingResource(pmr::memory_resource *upstream) :
+            upstream_(upstream) {
+    }
+
+    size_t allocations = 0;
+
+private:
+    pmr::memory_resource *upstream_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocations;
+        return upstream_->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        upstream_->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void TestQueryArena() {
+    SearchServer server("и в на"s);
+    for (int id = 0; id < 300; ++id) {
+        server.AddDocument(id, "кот"s + (id % 2 == 0 ? " пёс"s : " ёж"s)
+                + (id % 7 == 0 ? " хвост"s : ""s), DocumentStatus::ACTUAL,
+                { id % 5 });
+    }
+    const string query = "кот пёс и -хвост"s;
+    const vector<Document> expected = server.FindTopDocuments(query);
+    ASSERT_EQUAL(expected.size(), server.GetMaxResultDocumentCount());
+
+    const auto check_same = [&expected](const vector<Document> &documents) {
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+            ASSERT_EQUAL(documents[i].relevance, expected[i].relevance);
+        }
+    };
+
+    // Временная память запроса берётся у ресурса вызывающего
+    {
+        pmr::monotonic_buffer_resource buffer;
+        CountingResource counting(&buffer);
+        QueryMemoryScope scope(&counting);
+        check_same(server.FindTopDocuments(query));
+        ASSERT_EQUAL(counting.allocations > 0, true);
+
+        const size_t allocations = counting.allocations;
+        server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+        check_same(server.FindTopDocuments(query));
+        server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+        check_same(server.FindTopDocuments(execution::par, query));
+        const auto [words, status] = server.MatchDocument(query, 2);
+        ASSERT_EQUAL(words.size(), 2u);
+        ASSERT_EQUAL(counting.allocations > allocations, true);
+    }
+
+    // Повторные запросы переиспользуют арену потока
+    for (int i = 0; i < 3; ++i) {
+        check_same(server.FindTopDocuments(query));
+    }
+
+    // Вложенный запрос из предиката делит арену с внешним
+    const vector<Document> nested = server.FindTopDocuments("ёж"s,
+            [&server](int document_id, DocumentStatus, int) {
+                const auto [words, status] = server.MatchDocument("хвост"s,
+                        document_id);
+                return words.empty()
+                        && !server.FindTopDocuments("хвост"s).empty();
+            });
+    ASSERT_EQUAL(nested.empty(), false);
+    for (const Document &document : nested) {
+        ASSERT_EQUAL(document.id % 7 != 0, true);
+        ASSERT_EQUAL(document.id % 2, 1);
+    }
+
+    // Ошибка разбора не портит арену
+    try {
+        server.FindTopDocuments("кот --пёс"s);
+        ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение"s);
+    } catch (const invalid_argument&) {
+    }
+    check_same(server.FindTopDocuments(query));
+}
+
+void TestDocumentTable() {
+    DocumentTable table;
+    ASSERT_EQUAL(table.Find(0), DocumentTable::NO_DOCUMENT);
+    ASSERT_EQUAL(table.Remove(0), false);
+
+    // Кратные 1024 идентификаторы и несколько перестроений таблицы
+    vector<int> ids;
+    for (int i = 0; i < 1000; ++i) {
+        ids.push_back(i % 2 == 0 ? i * 1024 : 1000000 - i);
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ASSERT_EQUAL(table.Add(ids[i], static_cast<int>(i),
+                i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL),
+                static_cast<uint32_t>(i));
+    }
+    ASSERT_EQUAL(table.Size(), ids.size());
+    ASSERT_EQUAL(table.Find(1), DocumentTable::NO_DOCUMENT);
+
+    // Удаление не меняет номера остальных документов
+    for (size_t i = 0; i < ids.size(); i += 7) {
+        ASSERT_EQUAL(table.Remove(ids[i]), true);
+    }
+    ASSERT_EQUAL(table.Remove(ids[0]), false);
+    auto check_order = [&](const vector<size_t> &live) {
+        ASSERT_EQUAL(table.Size(), live.size());
+        for (size_t index = 0; index < live.size(); ++index) {
+            const size_t i = live[index];
+            const uint32_t ordinal = table.OrdinalAt(index);
+            ASSERT_EQUAL(table.Find(ids[i]), ordinal);
+            ASSERT_EQUAL(table.IsRemoved(ordinal), false);
+            ASSERT_EQUAL(table.Id(ordinal), ids[i]);
+            ASSERT_EQUAL(table.Rating(ordinal), static_cast<int>(i));
+            ASSERT_EQUAL(table.Status(ordinal) == DocumentStatus::BANNED,
+                    i % 3 == 0);
+            ASSERT_EQUAL(table.Ids()[index], ids[i]);
+        }
+    };
+    vector<size_t> live;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i % 7 == 0) {
+            ASSERT_EQUAL(table.Contains(ids[i]), false);
+            ASSERT_EQUAL(table.IsRemoved(static_cast<uint32_t>(i)), true);
+        } else {
+            ASSERT_EQUAL(table.Find(ids[i]), static_cast<uint32_t>(i));
+            live.push_back(i);
+        }
+    }
+    ASSERT_EQUAL(table.OrdinalCount(), static_cast<uint32_t>(ids.size()));
+    check_order(live);
+
+    // Когда пустых номеров больше, чем документов, номера уплотняются
+    // с сохранением порядка добавления
+    vector<size_t> kept;
+    for (size_t i : live) {
+        if (i % 5 == 0) {
+            kept.push_back(i);
+        } else {
+            ASSERT_EQUAL(table.Remove(ids[i]), true);
+        }
+    }
+    ASSERT_EQUAL(table.OrdinalCount() < ids.size(), true);
+    check_order(kept);
+    const uint32_t added = table.Add(7, -1, DocumentStatus::REMOVED);
+    ASSERT_EQUAL(added, table.OrdinalCount() - 1);
+    ASSERT_EQUAL(table.Id(table.OrdinalAt(kept.size())), 7);
+    ASSERT_EQUAL(table.IsDirect(), false);
+
+    // Небольшие идентификаторы ищутся в массиве, пока не встретится большой
+    DocumentTable direct;
+    for (int id = 299; id >= 0; --id) {
+        direct.Add(id, id, DocumentStatus::ACTUAL);
+    }
+    ASSERT_EQUAL(direct.IsDirect(), true);
+    ASSERT_EQUAL(direct.Find(-1), DocumentTable::NO_DOCUMENT);
+    ASSERT_EQUAL(direct.Find(300), DocumentTable::NO_DOCUMENT);
+    for (int id = 0; id < 300; id += 2) {
+        ASSERT_EQUAL(direct.Remove(id), true);
+    }
+    ASSERT_EQUAL(direct.Remove(0), false);
+    for (int id = 0; id < 300; id += 3) {
+        if (id % 2 == 1) {
+            ASSERT_EQUAL(direct.Remove(id), true);
+        }
+    }
+    ASSERT_EQUAL(direct.OrdinalCount() < 300u, true);
+    auto check_direct = [&direct] {
+        for (int id = 0; id < 300; ++id) {
+            const uint32_t ordinal = direct.Find(id);
+            if (id % 2 == 0 || id % 3 == 0) {
+                ASSERT_EQUAL(ordinal, DocumentTable::NO_DOCUMENT);
+            } else {
+                ASSERT_EQUAL(direct.Id(ordinal), id);
+            }
+        }
+    };
+    check_direct();
+    direct.Add(1 << 30, 0, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(direct.IsDirect(), false);
+    ASSERT_EQUAL(direct.Id(direct.Find(1 << 30)), 1 << 30);
+    check_direct();
+
+    // Сервер: порядок добавления после удаления, повторный идентификатор
+    SearchServer server("и"s);
+    server.AddDocument(5, "кот"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(1, "кот пёс"s, DocumentStatus::BANNED, { 7 });
+    server.AddDocument(9, "пёс"s, DocumentStatus::ACTUAL, { 1 });
+    server.RemoveDocument(5);
+    ASSERT_EQUAL(server.GetDocumentId(0), 1);
+    ASSERT_EQUAL(server.GetDocumentId(1), 9);
+    try {
+        server.AddDocument(9, "ёж"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение"s);
+    } catch (const invalid_argument&) {
+    }
+    server.AddDocument(5, "кот"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT_EQUAL(server.GetDocumentId(2), 5);
+    const vector<Document> banned = server.FindTopDocuments("кот"s,
+            DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned.size(), 1u);
+    ASSERT_EQUAL(banned[0].rating, 7);
+    const vector<Document> actual = server.FindTopDocuments("кот пёс"s);
+    ASSERT_EQUAL(actual.size(), 2u);
+}
+
+void TestScoreAccumulators() {
+    // Сравнивает плотный накопитель с хеш-таблицей и с MAX_SCORE
+    const auto check_accumulators = [](const SearchServer &server,
+            const vector<string> &queries) {
+        SearchServer sparse_server = server;
+        sparse_server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+        // Из предиката внешнего запроса массив потока занят, поэтому
+        // вложенный запрос считает в хеш-таблице
+        for (const string &query : queries) {
+            const vector<Document> dense = server.FindTopDocuments(query);
+            const vector<Document> max_score = sparse_server.FindTopDocuments(
+                    query);
+            vector<Document> sparse;
+            bool nested = false;
+            server.FindTopDocuments("кот"s, [&](int, DocumentStatus, int) {
+                if (!nested) {
+                    nested = true;
+                    sparse = server.FindTopDocuments(query);
+                }
+                return true;
+            });
+            ASSERT_EQUAL(dense.empty(), false);
+            ASSERT_EQUAL(sparse.size(), dense.size());
+            ASSERT_EQUAL(max_score.size(), dense.size());
+            for (size_t i = 0; i < dense.size(); ++i) {
+                ASSERT_EQUAL(sparse[i].id, dense[i].id);
+                ASSERT_EQUAL(sparse[i].relevance, dense[i].relevance);
+                ASSERT_EQUAL(max_score[i].id, dense[i].id);
+                ASSERT_EQUAL(max_score[i].relevance, dense[i].relevance);
+            }
+        }
+    };
+
+    SearchServer server("и"s);
+    for (int id = 0; id < 640; ++id) {
+        string text = "кот"s;
+        if (id % 3 == 0) {
+            text += " пёс пёс"s;
+        }
+        if (id % 200 == 7) {
+            text += " ёж"s;
+        }
+        server.AddDocument(id * 5, text, DocumentStatus::ACTUAL, { id % 9 });
+    }
+    server.SetMaxResultDocumentCount(1000);
+
+    // Слово из всех документов: IDF нулевой, но документы в выдаче
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 640u);
+    check_accumulators(server, { "пёс -ёж"s, "ёж"s, "кот пёс ёж"s });
+    ASSERT_EQUAL(server.FindTopDocuments("ёж"s).size(), 4u);
+    ASSERT_EQUAL(server.FindTopDocuments("пёс -ёж"s).size(), 213u);
+
+    // Идентификаторы разбросаны шире MAX_DOCUMENTS: плотный массив считает
+    // окнами, блоки списков попадают на границы окон, таблица документов
+    // не прямая
+    SearchServer wide_server("и"s);
+    const int stride = 2999;
+    for (int id = 0; id < 1500; ++id) {
+        string text = "кот"s;
+        if (id % 2 == 0) {
+            text += " пёс"s;
+        }
+        if (id % 5 == 0) {
+            text += " ёж ёж"s;
+        }
+        wide_server.AddDocument(id * stride, text, DocumentStatus::ACTUAL,
+                { id % 7 });
+    }
+    wide_server.AddDocument(numeric_limits<int>::max(), "кот пёс ёж"s,
+            DocumentStatus::ACTUAL, { 1 });
+    wide_server.SetMaxResultDocumentCount(2000);
+    ASSERT_EQUAL(1500u * stride > 3 * DenseScores::MAX_DOCUMENTS, true);
+    check_accumulators(wide_server, { "пёс -ёж"s, "ёж"s, "кот пёс ёж"s });
+    const vector<Document> wide = wide_server.FindTopDocuments("пёс -ёж"s);
+    ASSERT_EQUAL(wide.size(), 600u);
+    for (const Document &document : wide) {
+        ASSERT_EQUAL(document.id % stride, 0);
+        ASSERT_EQUAL(document.id / stride % 2, 0);
+        ASSERT_EQUAL(document.id / stride % 5 != 0, true);
+    }
+    ASSERT_EQUAL(wide_server.FindTopDocuments("ёж"s).size(), 301u);
+}
+
+void TestQueryStats() {
+    SearchServer server("и"s);
+    server.AddDocument(1, "кот и пёс"s, DocumentStatus::ACTUAL, { 5 });
+    server.AddDocument(2, "кот кот ёж"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(3, "пёс ёж"s, DocumentStatus::BANNED, { 1 });
+    server.AddDocument(4, "кот попугай"s, DocumentStatus::ACTUAL, { 2 });
+
+    // Статистика не меняет выдачу и пересчитывается заново
+    QueryStats stats;
+    stats.results_returned = 100;
+    const vector<Document> expected = server.FindTopDocuments("кот пёс -ёж"s);
+    const vector<Document> documents = server.FindTopDocuments("кот пёс -ёж"s,
+            DocumentStatus::ACTUAL, stats);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected[i].id);
+    }
+    ASSERT_EQUAL(stats.results_returned, 2u);
+    // Три вхождения «кот» и два «пёс»; документы 2 и 3 с «ёж» отброшены
+    // до подсчёта релевантности
+    ASSERT_EQUAL(stats.postings_scanned, 5u);
+    ASSERT_EQUAL(stats.candidates_scored, 2u);
+
+    // Время предиката не входит в остальные фазы. Часы читаются только
+    // на части вызовов, остальные оцениваются по ним.
+    const auto sleep = chrono::milliseconds(20);
+    server.FindTopDocuments("кот"s, [sleep](int, DocumentStatus, int) {
+        this_thread::sleep_for(sleep);
+        return true;
+    }, stats);
+    ASSERT_EQUAL(stats.PhaseTime(QueryPhase::PREDICATE) >= 2 * sleep, true);
+    ASSERT_EQUAL(stats.PhaseTime(QueryPhase::SORTING) < sleep, true);
+    ASSERT_EQUAL(stats.results_returned, 3u);
+
+    server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+    server.FindTopDocuments("кот пёс"s, DocumentStatus::ACTUAL, stats);
+    ASSERT_EQUAL(stats.results_returned, 3u);
+    ASSERT_EQUAL(stats.candidates_scored >= 3u, true);
+    server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+
+    const auto [words, status] = server.MatchDocument("пёс кот слон"s, 1,
+            stats);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(stats.results_returned, 2u);
+    ASSERT_EQUAL(stats.candidates_scored, 1u);
+    server.MatchDocument("пёс -кот"s, 1, stats);
+    ASSERT_EQUAL(stats.results_returned, 0u);
+
+    // Очередь суммирует статистику и отдаёт счётчики Prometheus
+    RequestQueue request_queue(server);
+    request_queue.AddFindRequest("кот"s);
+    ASSERT_EQUAL(request_queue.GetQueryStats().results_returned, 0u);
+    request_queue.EnableQueryStats();
+    request_queue.AddFindRequest("кот"s);
+    request_queue.AddFindRequest("слон"s);
+    request_queue.AddFindRequest("пёс"s, [](int, DocumentStatus, int) {
+        return true;
+    });
+    const QueryStats total = request_queue.GetQueryStats();
+    ASSERT_EQUAL(total.results_returned, 5u);
+    ASSERT_EQUAL(total.postings_scanned, 5u);
+
+    ostringstream metrics;
+    request_queue.WritePrometheusMetrics(metrics);
+    const string text = metrics.str();
+    ASSERT_EQUAL(text.find("search_requests_total 4\n"s) != string::npos, true);
+    ASSERT_EQUAL(text.find("search_empty_requests_total 1\n"s) != string::npos,
+            true);
+    ASSERT_EQUAL(text.find("search_query_phase_seconds_total{phase=\"predicate\"}"s)
+            != string::npos, true);
+    ASSERT_EQUAL(text.find("search_results_returned_total 5\n"s) != string::npos,
+            true);
+}
+
+void TestAsyncQueries() {
+    SearchServer server("и"s);
+    for (int id = 0; id < 1000; ++id) {
+        server.AddDocument(id, "кот"s + (id % 3 == 0 ? " пёс"s : ""s),
+                DocumentStatus::ACTUAL, { id % 10 });
+    }
+    try {
+        server.FindTopDocumentsAsync("кот"s, chrono::seconds(1));
+        ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение logic_error"s);
+    } catch (const logic_error&) {
+    }
+    server.EnableAsyncQueries(1, 1);
+
+    // Результат совпадает с синхронным поиском
+    const vector<Document> expected = server.FindTopDocuments("кот пёс"s);
+    SearchServer::SearchResult result = server.FindTopDocumentsAsync(
+            "кот пёс"s, chrono::seconds(10)).get();
+    ASSERT_EQUAL(result.partial, false);
+    ASSERT_EQUAL(result.documents.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(result.documents[i].id, expected[i].id);
+        ASSERT_EQUAL(result.documents[i].relevance, expected[i].relevance);
+    }
+
+    // Поток занят, одна задача в очереди, следующая отклоняется сразу
+    promise<void> release;
+    shared_future<void> released = release.get_future().share();
+    promise<void> started;
+    auto blocked = server.FindTopDocumentsAsync("пёс"s,
+            [released, &started](int document_id, DocumentStatus, int) {
+                if (document_id == 0) {
+                    started.set_value();
+                    released.wait();
+                }
+                return true;
+            }, chrono::seconds(10));
+    started.get_future().wait();
+    auto queued = server.FindTopDocumentsAsync("кот"s, DocumentStatus::ACTUAL,
+            chrono::seconds(10));
+    try {
+        server.FindTopDocumentsAsync("кот"s, chrono::seconds(10));
+        ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение QueryRejected"s);
+    } catch (const QueryRejected&) {
+    }
+    release.set_value();
+    ASSERT_EQUAL(blocked.get().documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(queued.get().partial, false);
+
+    // Срок истёк до начала выполнения
+    result = server.FindTopDocumentsAsync("кот"s, chrono::seconds(0)).get();
+    ASSERT_EQUAL(result.partial, true);
+    ASSERT_EQUAL(result.documents.empty(), true);
+
+    // Срок истекает во время отбора: выдача из уже посчитанных документов
+    server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+    result = server.FindTopDocumentsAsync("кот"s,
+            [](int document_id, DocumentStatus, int) {
+                if (document_id == 0) {
+                    this_thread::sleep_for(chrono::milliseconds(100));
+                }
+                return true;
+            }, chrono::milliseconds(50)).get();
+    ASSERT_EQUAL(result.partial, true);
+    ASSERT_EQUAL(result.documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    // Срок проверяется раз в 128 документов
+    for (const Document &document : result.documents) {
+        ASSERT_EQUAL(document.id < 128, true);
+    }
+
+    // Ошибка запроса приходит через future
+    auto invalid = server.FindTopDocumentsAsync("кот --пёс"s,
+            chrono::seconds(10));
+    try {
+        invalid.get();
+        ASSERT_EQUAL_HINT(false, true, "Ожидалось исключение invalid_argument"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestChunkedVector() {
+    const size_t chunk = ChunkedVector<int>::CHUNK_SIZE;
+    ChunkedVector<int> values;
+    for (size_t i = 0; i < chunk * 3 + 5; ++i) {
+        values.PushBack(static_cast<int>(i));
+    }
+    ASSERT_EQUAL(values.Size(), chunk * 3 + 5);
+
+    // Изменения после копирования видны только в своём массиве
+    const ChunkedVector<int> copy = values;
+    values.Mutable(1) = -1;
+    values.Mutable(chunk * 2) = -2;
+    values.PushBack(-3);
+    ASSERT_EQUAL(values[1], -1);
+    ASSERT_EQUAL(values[chunk * 2], -2);
+    ASSERT_EQUAL(values[chunk * 3 + 5], -3);
+    ASSERT_EQUAL(copy[1], 1);
+    ASSERT_EQUAL(copy[chunk * 2], static_cast<int>(chunk * 2));
+    ASSERT_EQUAL(copy.Size(), chunk * 3 + 5);
+
+    // Уменьшение и рост заполняют новые элементы заданным значением
+    values.Resize(chunk + 1);
+    values.Resize(chunk * 2 + 3, 7);
+    ASSERT_EQUAL(values[chunk], static_cast<int>(chunk));
+    ASSERT_EQUAL(values[chunk + 1], 7);
+    ASSERT_EQUAL(values[chunk * 2 + 2], 7);
+    ASSERT_EQUAL(copy[chunk + 1], static_cast<int>(chunk + 1));
+
+    ChunkedVector<int> moved = move(values);
+    ASSERT_EQUAL(values.Empty(), true);
+    ASSERT_EQUAL(moved.Size(), chunk * 2 + 3);
+    values.Assign(3, 4);
+    ASSERT_EQUAL(values[2], 4);
+    ASSERT_EQUAL(moved[0], 0);
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeMinusWordsFromAddedDocumentContent);
     RUN_TEST(TestAddedDocumentContent);
@@ -269,5 +2016,31 @@ void TestSearchServer() {
     RUN_TEST(TestMatchedMinusWordsDoNotResetPlusWords1);
     RUN_TEST(TestQueue);
     RUN_TEST(TestPage);
+    RUN_TEST(TestUnorderedDocumentIds);
+    RUN_TEST(TestParallelSearch);
+    RUN_TEST(TestMaxResultDocumentCount);
+    RUN_TEST(TestStringViewInput);
+    RUN_TEST(TestRemoveDocument);
+    RUN_TEST(TestProcessQueries);
+    RUN_TEST(TestIdfUpdatesOnAddDocument);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestRequestQueueStats);
+    RUN_TEST(TestLiveSearchServer);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestCompressedPostings);
+    RUN_TEST(TestMaxScoreRetrieval);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestMatchDocumentForwardIndex);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestLazyPaginator);
+    RUN_TEST(TestSearchAfter);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestQueryArena);
+    RUN_TEST(TestDocumentTable);
+    RUN_TEST(TestScoreAccumulators);
+    RUN_TEST(TestQueryStats);
+    RUN_TEST(TestAsyncQueries);
+    RUN_TEST(TestChunkedVector);
 }
 
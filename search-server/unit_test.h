@@ -49,6 +49,58 @@ void TestFilterUserPredicateDoc();
 void TestPage();
 // Тестирование очереди запросов
 void TestQueue();
+// Документы, добавленные не по порядку идентификаторов, находятся и сопоставляются корректно
+void TestUnorderedDocumentIds();
+// Параллельные версии поиска и сопоставления дают тот же результат, что и последовательные
+void TestParallelSearch();
+// Количество возвращаемых документов настраивается, порядок выдачи сохраняется
+void TestMaxResultDocumentCount();
+// Документы и запросы принимаются как string_view, словарь не зависит от времени жизни исходных строк
+void TestStringViewInput();
+// Удаление документов: документ пропадает из выдачи, IDF пересчитывается, прямой индекс очищается
+void TestRemoveDocument();
+// Пакетная обработка запросов возвращает результаты в порядке запросов
+void TestProcessQueries();
+// IDF слов обновляется при каждом добавлении документа
+void TestIdfUpdatesOnAddDocument();
+// Сохранение индекса в снимок и поиск по отображённому в память снимку
+void TestSnapshot();
+// Кэш результатов: нормализация запроса, сброс при изменении индекса, ограничение памяти
+void TestQueryCache();
+// Статистика очереди запросов: окно в сутки по минутам, QPS, задержки, запись из потоков
+void TestRequestQueueStats();
+// Копии сервера независимы; читатели LiveSearchServer видят согласованные версии
+void TestLiveSearchServer();
+// Пакетное добавление совпадает с последовательным и отклоняет ошибочный пакет целиком
+void TestAddDocuments();
+// Сжатые списки вхождений: несколько блоков, вставки в середину, удаление, снимок
+void TestCompressedPostings();
+// Отбор MAX_SCORE совпадает с полным подсчётом релевантности
+void TestMaxScoreRetrieval();
+// Множество документов с минус-словами: разреженные и плотные контейнеры, поиск и MatchDocument
+void TestDocumentBitmap();
+// MatchDocument по прямому индексу: слова из словаря сервера, слияние и поиск, снимок
+void TestMatchDocumentForwardIndex();
+// Разделённый на шарды сервер выдаёт то же, что один сервер с теми же документами
+void TestShardedSearchServer();
+// Ленивый Paginator: страницы по запросу, пустой диапазон, ошибка нулевого размера
+void TestLazyPaginator();
+// Постраничный поиск по курсору повторяет полную выдачу
+void TestSearchAfter();
+// Словарь терминов: плотные идентификаторы, рост таблицы, копии, флаги стоп-слов
+void TestTermDictionary();
+// Временная память запроса: арена потока, ресурс вызывающего, вложенные запросы
+void TestQueryArena();
+// Таблица документов: порядковые номера, удаление со сдвигом, рейтинг и статус
+void TestDocumentTable();
+// Плотный и хеш-накопители релевантности дают одинаковую выдачу
+void TestScoreAccumulators();
+// Статистика выполнения запросов: фазы, объём работы, счётчики очереди
+void TestQueryStats();
+// Асинхронный поиск: пул с ограниченной очередью, срок запроса, неполная выдача
+void TestAsyncQueries();
+// Массив из частей: копия разделяет части, изменение копирует только свою часть
+void TestChunkedVector();
 
 /*
  Разместите код остальных тестов здесь